@@ -0,0 +1,47 @@
+/* Benchmark: allocating small llib objects with the size-class allocator
+* versus plain malloc.
+*
+*   ./bench-alloc [n]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <llib/str.h>
+#include <llib/value.h>
+
+#define ROUNDS 10
+
+static double run(int n) {
+    void **objs = (void**)malloc(sizeof(void*)*n);
+    clock_t start = clock();
+    FOR(r,ROUNDS) {
+        // a mix of strings and boxed values, freed in a scrambled order
+        FOR(i,n) {
+            if (i % 3 == 0)
+                objs[i] = value_int(i);
+            else
+                objs[i] = str_new(i % 3 == 1 ? "hello" : "hello dolly, how are you today?");
+        }
+        for (int i = 0; i < n; i += 2)
+            obj_unref(objs[i]);
+        for (int i = 1; i < n; i += 2)
+            obj_unref(objs[i]);
+    }
+    double secs = (double)(clock() - start)/CLOCKS_PER_SEC;
+    free(objs);
+    return 1.0e9*secs/((double)n*ROUNDS);
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : 1000000;
+    obj_slab_enable(false);
+    double t_malloc = run(n);
+    obj_slab_enable(true);
+    double t_slab = run(n);
+    printf("%d objects x %d rounds\n",n,ROUNDS);
+    printf("malloc %6.1f ns/object\n",t_malloc);
+    printf("slab   %6.1f ns/object\n",t_slab);
+    obj_slab_dump();
+    printf("kount %d\n",obj_kount());
+    return 0;
+}
@@ -0,0 +1,119 @@
+/* Benchmark: the B-tree map against the balanced-tree map, with keys put
+* in random order. Integer and string keys are timed for put, get,
+* iteration and delete, by default at a million and ten million keys.
+*
+*   ./bench-bmap [n...]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <llib/map.h>
+#include <llib/bmap.h>
+
+static clock_t start;
+
+static void begin() {
+    start = clock();
+}
+
+static void report(const char *what, const char *kind, int n) {
+    double secs = (double)(clock() - start)/CLOCKS_PER_SEC;
+    printf("%-12s %-8s %8.1f ns/op\n",what,kind,1.0e9*secs/n);
+}
+
+static void check(intptr_t got, intptr_t expected) {
+    if (got != expected)
+        printf("bad result %d!\n",(int)got);
+}
+
+static void map_keys(void **keys, int n, bool strings) {
+    const char *kind = strings ? "string map" : "int map";
+    Map *m = strings ? map_new_str_ptr() : map_new_ptr_ptr();
+    begin();
+    FOR(i,n)
+        map_put(m,keys[i],(void*)(intptr_t)i);
+    report(kind,"put",n);
+    begin();
+    intptr_t sum = 0;
+    FOR(i,n)
+        sum += (intptr_t)map_get(m,keys[i]);
+    report(kind,"get",n);
+    check(sum,(intptr_t)n*(n-1)/2);
+    begin();
+    sum = 0;
+    FOR_MAP(iter,m)
+        sum += (intptr_t)iter->value;
+    report(kind,"iterate",n);
+    begin();
+    FOR(i,n)
+        map_delete(m,keys[i]);
+    report(kind,"delete",n);
+    check(map_size(m),0);
+    unref(m);
+}
+
+static void bmap_keys(void **keys, int n, bool strings) {
+    const char *kind = strings ? "string bmap" : "int bmap";
+    BMap *m = strings ? bmap_new_str_ptr() : bmap_new_ptr_ptr();
+    begin();
+    FOR(i,n)
+        bmap_put(m,keys[i],(void*)(intptr_t)i);
+    report(kind,"put",n);
+    begin();
+    intptr_t sum = 0;
+    FOR(i,n)
+        sum += (intptr_t)bmap_get(m,keys[i]);
+    report(kind,"get",n);
+    check(sum,(intptr_t)n*(n-1)/2);
+    begin();
+    sum = 0;
+    void *key, *value;
+    FOR_BMAP(key,value,m)
+        sum += (intptr_t)value;
+    report(kind,"iterate",n);
+    begin();
+    FOR(i,n)
+        bmap_delete(m,keys[i]);
+    report(kind,"delete",n);
+    check(bmap_size(m),0);
+    unref(m);
+}
+
+static void run(int n) {
+    void **keys = array_new(void*,n);
+    FOR(i,n)
+        keys[i] = (void*)(intptr_t)i;
+    srand(42);
+    for (int i = n - 1; i > 0; i--) {
+        int j = (int)(((double)rand()/((double)RAND_MAX + 1))*(i + 1));
+        void *t = keys[i];
+        keys[i] = keys[j];
+        keys[j] = t;
+    }
+    printf("%d keys\n",n);
+    map_keys(keys,n,false);
+    bmap_keys(keys,n,false);
+
+    // plain strings, since the maps would take over refcounted keys
+    char *buff = (char*)malloc(10*(size_t)n);
+    FOR(i,n) {
+        char *s = buff + 10*(size_t)i;
+        sprintf(s,"%09d",(int)(intptr_t)keys[i]);
+        keys[i] = s;
+    }
+    map_keys(keys,n,true);
+    bmap_keys(keys,n,true);
+    free(buff);
+    unref(keys);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++)
+            run(atoi(argv[i]));
+    } else {
+        run(1000000);
+        run(10000000);
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+/* Benchmark: map insertion and lookup with sorted, reverse-sorted and
+* random keys. Maps are balanced trees, so sorted keys cost about the
+* same as random ones. Both integer and string keys are timed, and
+* the same is done for hash maps. Sorted pairs can also be put all at once,
+* and integer maps are timed again with their own node slab. Flat maps
+* built from the maps are timed for lookup.
+*
+*   ./bench-map [n]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <llib/map.h>
+#include <llib/hmap.h>
+#include <llib/fmap.h>
+
+static clock_t start;
+
+static void begin() {
+    start = clock();
+}
+
+static void report(const char *what, const char *order, int n) {
+    double secs = (double)(clock() - start)/CLOCKS_PER_SEC;
+    printf("%-12s %-8s %8.1f ns/op\n",what,order,1.0e9*secs/n);
+}
+
+static void int_keys(intptr_t *keys, int n, const char *order, bool slab) {
+    Map *m = map_new_ptr_ptr();
+    if (slab)
+        map_use_node_slab(m);
+    begin();
+    FOR(i,n)
+        map_put(m,(void*)keys[i],(void*)(intptr_t)i);
+    report(slab ? "slab put" : "int put",order,n);
+    if (slab) { // just the bulk release is of interest
+        begin();
+        unref(m);
+        report("slab free",order,n);
+        return;
+    }
+    begin();
+    intptr_t sum = 0;
+    FOR(i,n)
+        sum += (intptr_t)map_get(m,(void*)keys[i]);
+    report("int get",order,n);
+    if (sum != (intptr_t)n*(n-1)/2)
+        printf("bad sum!\n");
+    FMap *f = fmap_from_map(m);
+    begin();
+    sum = 0;
+    FOR(i,n)
+        sum += fmap_geti(f,keys[i]);
+    report("flat get",order,n);
+    if (sum != (intptr_t)n*(n-1)/2)
+        printf("bad sum!\n");
+    unref(f);
+    begin();
+    sum = 0;
+    FOR_MAP(iter,m)
+        sum += (intptr_t)iter->value;
+    report("int iterate",order,n);
+    begin();
+    unref(m);
+    report("int free",order,n);
+}
+
+static void str_keys(char **keys, int n, const char *order) {
+    Map *m = map_new_str_ptr();
+    begin();
+    FOR(i,n)
+        map_put(m,keys[i],keys[i]);
+    report("string put",order,n);
+    begin();
+    int found = 0;
+    FOR(i,n)
+        found += map_get(m,keys[i]) != NULL;
+    report("string get",order,n);
+    if (found != n)
+        printf("bad count!\n");
+    FMap *f = fmap_from_map(m);
+    begin();
+    found = 0;
+    FOR(i,n)
+        found += fmap_get(f,keys[i]) != NULL;
+    report("flat str get",order,n);
+    if (found != n)
+        printf("bad count!\n");
+    unref(f);
+    unref(m);
+}
+
+static void hash_keys(char **keys, int n, const char *order) {
+    HMap *m = hmap_new_str_ptr();
+    begin();
+    FOR(i,n)
+        hmap_put(m,keys[i],keys[i]);
+    report("hash put",order,n);
+    begin();
+    int found = 0;
+    FOR(i,n)
+        found += hmap_get(m,keys[i]) != NULL;
+    report("hash get",order,n);
+    if (found != n)
+        printf("bad count!\n");
+    unref(m);
+}
+
+static void run(intptr_t *keys, int n, const char *order) {
+    // plain strings, since the maps would take over refcounted keys
+    char *buff = (char*)malloc(10*n);
+    char **skeys = array_new(char*,n);
+    FOR(i,n) {
+        skeys[i] = buff + 10*i;
+        sprintf(skeys[i],"%09d",(int)keys[i]);
+    }
+    int_keys(keys,n,order,false);
+    int_keys(keys,n,order,true);
+    str_keys(skeys,n,order);
+    hash_keys(skeys,n,order);
+    unref(skeys);
+    free(buff);
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : 1000000;
+    intptr_t *keys = array_new(intptr_t,n);
+    printf("%d keys\n",n);
+
+    FOR(i,n)
+        keys[i] = i;
+    run(keys,n,"sorted");
+
+    // sorted pairs can be put all at once
+    MapKeyValue *pkv = array_new(MapKeyValue,n);
+    FOR(i,n) {
+        pkv[i].key = (void*)keys[i];
+        pkv[i].value = (void*)keys[i];
+    }
+    Map *m = map_new_ptr_ptr();
+    begin();
+    map_put_sorted(m,pkv,n);
+    report("int bulk","sorted",n);
+    dispose(m,pkv);
+
+    FOR(i,n)
+        keys[i] = n - 1 - i;
+    run(keys,n,"reverse");
+
+    srand(42);
+    for (int i = n - 1; i > 0; i--) {
+        int j = (int)(((double)rand()/((double)RAND_MAX + 1))*(i + 1));
+        intptr_t t = keys[i];
+        keys[i] = keys[j];
+        keys[j] = t;
+    }
+    run(keys,n,"random");
+
+    unref(keys);
+    return 0;
+}
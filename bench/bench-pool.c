@@ -0,0 +1,37 @@
+/* Benchmark: cost of object pools as the number of pooled objects grows.
+* Half the temporaries are explicitly unref'd, which takes them out of the pool;
+* the rest are drained when the pool goes out of scope.  The time per object
+* should stay flat as the count doubles.
+*
+*   ./bench-pool [max]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <llib/str.h>
+
+static double run(int n) {
+    clock_t start = clock();
+    {
+        scoped_pool;
+        char **keep = array_new(char*,n);
+        FOR(i,n) {
+            keep[i] = str_fmt("temp %d",i);
+            if (i % 2 == 1) {
+                obj_unref(keep[i-1]);
+                keep[i-1] = NULL;
+            }
+        }
+    }
+    double secs = (double)(clock() - start)/CLOCKS_PER_SEC;
+    return 1.0e9*secs/n;
+}
+
+int main(int argc, char **argv) {
+    int max = argc > 1 ? atoi(argv[1]) : 1600000;
+    for (int n = 25000; n <= max; n *= 2) {
+        printf("%8d objects %6.1f ns/object\n",n,run(n));
+    }
+    printf("kount %d\n",obj_kount());
+    return 0;
+}
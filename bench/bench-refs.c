@@ -0,0 +1,90 @@
+/* Benchmark: biased reference counting versus plain atomic refcounts.
+* Objects created normally are owned by their thread, which updates their
+* counts without atomic operations; objects created in `scoped_shared` have
+* no owner, so every `ref` and `unref` is atomic.
+* Must be built with LLIB_THREADS against libllib_mt.a.
+*
+*   ./bench-refs [n] [threads]
+*/
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <llib/str.h>
+
+#define NOBJS 64
+
+typedef struct {
+    int n;
+    bool shared; // create the objects without owner
+    char **common; // if set, all threads use these objects
+} Job;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec + 1.0e-9*ts.tv_nsec;
+}
+
+// the kind of thing a worker does: take references, store them, release them
+static void *hammer(void *arg) {
+    Job *job = (Job*)arg;
+    char **objs = job->common, *held[NOBJS];
+    if (! objs) {
+        if (job->shared) {
+            scoped_shared;
+            objs = array_new_ref(char*,NOBJS);
+            FOR(i,NOBJS)
+                objs[i] = str_fmt("object %d",i);
+        } else {
+            objs = array_new_ref(char*,NOBJS);
+            FOR(i,NOBJS)
+                objs[i] = str_fmt("object %d",i);
+        }
+    }
+    FOR(k,job->n/NOBJS) {
+        FOR(i,NOBJS)
+            held[i] = ref(objs[i]);
+        FOR(i,NOBJS)
+            unref(held[i]);
+    }
+    if (! job->common)
+        unref(objs);
+    return NULL;
+}
+
+static double run(int nthreads, int n, bool shared, char **common) {
+    pthread_t threads[64];
+    Job job = {n, shared, common};
+    double start = now();
+    FOR(i,nthreads)
+        pthread_create(&threads[i],NULL,hammer,&job);
+    FOR(i,nthreads)
+        pthread_join(threads[i],NULL);
+    return 1.0e9*(now() - start)/((double)n*nthreads);
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : 10000000;
+    int nthreads = argc > 2 ? atoi(argv[2]) : 4;
+    if (nthreads > 64)
+        nthreads = 64;
+    printf("%d ref/unref pairs per thread\n",n);
+    printf("1 thread, owned        %6.2f ns/pair\n",run(1,n,false,NULL));
+    printf("1 thread, atomic       %6.2f ns/pair\n",run(1,n,true,NULL));
+    printf("%d threads, owned       %6.2f ns/pair\n",nthreads,run(nthreads,n,false,NULL));
+    printf("%d threads, atomic      %6.2f ns/pair\n",nthreads,run(nthreads,n,true,NULL));
+    // every thread refers to the same objects, so the shared counts are contended
+    char **common;
+    {
+        scoped_shared;
+        common = array_new_ref(char*,NOBJS);
+        FOR(i,NOBJS)
+            common[i] = str_fmt("common %d",i);
+    }
+    printf("%d threads, contended   %6.2f ns/pair\n",nthreads,run(nthreads,n,true,common));
+    unref(common);
+    printf("kount %d\n",obj_kount());
+    return 0;
+}
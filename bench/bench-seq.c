@@ -0,0 +1,65 @@
+/* Benchmark: growing sequences and string buffers.
+* Growth resizes the underlying array in place where it can, so that
+* appending does not copy everything at each doubling; `seq_reserve` and
+* `seq_add_n` avoid most of the capacity checks as well.
+*
+*   ./bench-seq [n]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <llib/str.h>
+
+#define CHUNK 1024
+
+static clock_t start;
+
+static void begin() {
+    start = clock();
+}
+
+static void report(const char *what, int n) {
+    double secs = (double)(clock() - start)/CLOCKS_PER_SEC;
+    printf("%-20s %6.2f ns/item\n",what,1.0e9*secs/n);
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : 10000000;
+    int vals[CHUNK];
+    FOR(i,CHUNK)
+        vals[i] = i;
+    printf("%d items\n",n);
+
+    begin();
+    int **s = seq_new(int);
+    FOR(i,n)
+        seq_add(s,i);
+    report("seq_add",n);
+    unref(s);
+
+    begin();
+    s = seq_new(int);
+    seq_reserve(s,n);
+    FOR(i,n)
+        seq_add(s,i);
+    report("seq_reserve+add",n);
+    unref(s);
+
+    begin();
+    s = seq_new(int);
+    for (int i = 0; i < n; i += CHUNK)
+        seq_add_n(s,vals,i + CHUNK <= n ? CHUNK : n - i);
+    report("seq_add_n",n);
+    unref(s);
+
+    begin();
+    char **sb = strbuf_new();
+    FOR(i,n)
+        strbuf_adds(sb,"hello ");
+    char *str = strbuf_tostring(sb);
+    report("strbuf_adds",n);
+    unref(str);
+
+    printf("kount %d\n",obj_kount());
+    return 0;
+}
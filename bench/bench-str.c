@@ -0,0 +1,96 @@
+/* Benchmark: the string searches with each level of SIMD (none, SSE2
+* and AVX2, as far as the CPU goes) against the C library, for short
+* and long haystacks. The match is always at the end. The haystack is
+* a refcounted string, so its array bounds the search; short or plain
+* strings are passed to the C library anyway.
+*
+*   ./bench-str [long-length]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <llib/str.h>
+
+static clock_t start;
+static int sink;
+
+static void begin() {
+    start = clock();
+}
+
+static void report(const char *what, const char *kind, int len, int n) {
+    double secs = (double)(clock() - start)/CLOCKS_PER_SEC;
+    printf("%-14s %-6s %8d %10.1f ns/op\n",what,kind,len,1.0e9*secs/n);
+}
+
+static void run(const char *kind, char *hay, int len, int n) {
+    begin();
+    FOR(i,n)
+        sink += str_findstr(hay,"needle");
+    report("findstr",kind,len,n);
+    begin();
+    FOR(i,n)
+        sink += str_find_first_of(hay,",;");
+    report("first_of",kind,len,n);
+    begin();
+    FOR(i,n)
+        sink += str_find_first_of(hay,",;:|!?");
+    report("first_of set",kind,len,n);
+    begin();
+    FOR(i,n)
+        sink += str_find_first_not_of(hay,"abcdefghij");
+    report("first_not_of",kind,len,n);
+    begin();
+    FOR(i,n)
+        sink += str_is_blank(hay);
+    report("is_blank",kind,len,n);
+}
+
+static void run_libc(char *hay, int len, int n) {
+    begin();
+    FOR(i,n)
+        sink += strstr(hay,"needle") - hay;
+    report("findstr","libc",len,n);
+    begin();
+    FOR(i,n)
+        sink += strpbrk(hay,",;") - hay;
+    report("first_of","libc",len,n);
+    begin();
+    FOR(i,n)
+        sink += strpbrk(hay,",;:|!?") - hay;
+    report("first_of set","libc",len,n);
+    begin();
+    FOR(i,n)
+        sink += strspn(hay,"abcdefghij");
+    report("first_not_of","libc",len,n);
+}
+
+// a haystack of letters with a near miss every so often, ending in the match
+static char *haystack(int len) {
+    char *s = str_new_size(len);
+    FOR(i,len)
+        s[i] = "abcdefghij"[i % 10];
+    for (int i = 0; i + 6 < len; i += 64)
+        memcpy(s + i,"needl",5);
+    memcpy(s + len - 7,";needle",7);
+    return s;
+}
+
+int main(int argc, char **argv) {
+    int lens[] = {24, 1000000};
+    if (argc > 1)
+        lens[1] = atoi(argv[1]);
+    const char *levels[] = {"bytes","sse2","avx2"};
+    FOR(k,2) {
+        int len = lens[k], n = len < 1000 ? 10000000 : 2000;
+        char *hay = haystack(len);
+        for (int level = 0; level <= 2; level++) {
+            if (str_simd_level(level) == level)
+                run(levels[level],hay,len,n);
+        }
+        run_libc(hay,len,n);
+        unref(hay);
+    }
+    str_simd_level(2);
+    return sink == 42;
+}
@@ -1,5 +1,6 @@
 /* Read all the words in a document and keep a
- * map of the unique words and the number of their occurances.
+ * hash map of the unique words and the number of their occurances.
+ * The count is updated in place, so each word is only looked up once.
  *
  * We then get the map out as an array of MapKeyValue structs,
  * and sort this by value so we get the most common words first.
@@ -7,7 +8,7 @@
 */
 #include <stdio.h>
 #include <stdlib.h>
-#include <llib/map.h>
+#include <llib/hmap.h>
 
 int main(int argc, char **argv)
 {
@@ -15,15 +16,16 @@ int main(int argc, char **argv)
     const char *file = argv[1] ? argv[1] : "../readme.md";
     FILE *in = fopen(file,"r");
 
-    Map *m = map_new_str_ptr();
+    HMap *m = hmap_new_str_ptr();
     int k = 0;
     while (fscanf(in,"%99s",word) == 1) {
-        map_puti(m,word,  map_geti(m,word) + 1);
+        intptr_t *count = (intptr_t*)hmap_put_ptr(m,word);
+        ++*count;
         ++k;
     }
     fclose(in);
 
-    MapKeyValue *pkv = map_to_array(m);
+    MapKeyValue *pkv = hmap_to_array(m);
     int sz = array_len(pkv);
     printf("unique words %d  out of %d\n",sz,k);
 
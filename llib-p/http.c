@@ -16,6 +16,7 @@
 #include <ctype.h>
 #include <llib/file.h>
 #include <llib/str.h>
+#include <llib/fmap.h>
 #include "http.h"
 
 static bool s_verbose = false;
@@ -25,6 +26,15 @@ void http_set_verbose(bool v) {
     s_verbose = v;
 }
 
+static bool s_intern_headers = false;
+
+/// intern the names of headers and variables.
+// Every request repeats the same names, which are then shared
+// and are found by pointer comparison in the header maps. See `str_intern`.
+void http_set_intern_headers(bool on) {
+    s_intern_headers = on;
+}
+
 /// escape any non-alphanumeric characters in an URL.
 char *http_url_encode (str_t val) {
     char **res = strbuf_new();
@@ -65,7 +75,7 @@ static char *decode(str_t s) {
 }
 
 static void var_put(char ***ss, str_t name, str_t value) {
-    smap_add(ss,str_new(name),str_new(value));
+    smap_add(ss,s_intern_headers ? str_intern(name) : str_new(name),str_new(value));
 }
 
 static char line[1024];
@@ -148,6 +158,7 @@ HttpResponse *http_request_read(int c) {
     }
     // this is safe even for binary returned values
     body[nreq] = 0;
+    str_len(body) = nreq;
     fclose(f);
 
     resp->body = body;
@@ -217,12 +228,15 @@ typedef struct {
 static RouteEntry routes[MAX_ROUTES];
 static int last_route = 0;
 
-static char *mime_types[] = {
-    "jpeg","image/jpeg","jpg","image/jpg","gif","image/gif","png","image/png",
-    "html","text/html","css","text/css","js","text/javascript",
-    NULL
+static MapKeyValue mime_pairs[] = {
+    {"jpeg","image/jpeg"},{"jpg","image/jpg"},{"gif","image/gif"},{"png","image/png"},
+    {"html","text/html"},{"css","text/css"},{"js","text/javascript"},
+    {NULL,NULL}
 };
 
+// looked up for every file served, so built once as a flat map
+static FMap *mime_types;
+
 static str_t static_handler(HttpRequest *web, void *user_data) {
     char file[512];
     str_t contents;
@@ -237,7 +251,7 @@ static str_t static_handler(HttpRequest *web, void *user_data) {
         return "<html><body><h1>file does not exist</h1></body></html>";
     } else {
         str_t ext = file_extension(file);
-        str_t mime = str_lookup(mime_types,ext);
+        str_t mime = (str_t)fmap_gets(mime_types,ext);
         if (! mime)
             mime = "text/plain";
         web->type = mime;
@@ -282,6 +296,8 @@ void http_add_static (const char *route, const char *path, int cache) {
             cache = 86400;
         cache_control = str_fmt("max-age=%d",cache);
     }
+    if (! mime_types)
+        mime_types = fmap_new_str_ptr(mime_pairs,-1);
     http_add_route(route,static_handler,cache_control);
     routes[last_route-1].local_path = path;
 }
@@ -34,6 +34,7 @@ typedef struct {
 } HttpContinuation;
 
 void http_set_verbose(bool v);
+void http_set_intern_headers(bool on);
 str_t http_var_get (HttpRequest *req, str_t name);
 bool http_var_set(char** substs, str_t name, str_t value);
 char *http_url_encode (str_t val);
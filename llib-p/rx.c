@@ -202,6 +202,13 @@ char *rx_group(Regex *R, int idx) {
     return str_sub(R->s,M->rm_so+R->offs,M->rm_eo+R->offs);    
 }
 
+/// n-th group of match as a view into the matched string.
+// Nothing is copied; see `str_view`.
+StrView rx_group_view(Regex *R, int idx) {
+    regmatch_t *M = &R->matches[idx];
+    return str_view_len(R->s + M->rm_so + R->offs,M->rm_eo - M->rm_so);
+}
+
 // turn an index 'n' into the nth captured string
 static str_t lookup_capture(Regex *R, str_t cap) {
     int idx = (int)*cap - (int)'0' ;  // '1' -> 1, etc
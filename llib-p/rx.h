@@ -27,6 +27,7 @@ char **rx_match_groups(Regex *R, str_t s);
 bool rx_find(Regex *R, str_t s, int *pi1, int *pi2);
 int rx_group_count(Regex *R);
 char *rx_group(Regex *R, int idx);
+StrView rx_group_view(Regex *R, int idx);
 char* rx_gsub (Regex *R, str_t s, StrLookup lookup, void *data);
 bool rx_subst (Regex *R, str_t s, char** ss, int *pi1);
 
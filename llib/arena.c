@@ -0,0 +1,262 @@
+/*
+* llib little C library
+* BSD licence
+* Copyright Steve Donovan, 2013
+*/
+
+/***
+### Arenas: Bulk Allocation and Release.
+
+An arena is like an object pool, except that no object created in its scope
+is tracked or freed individually.  Objects are simply carved one after another
+out of large chunks, `obj_unref` does nothing to them, and the whole lot is
+released when the arena is disposed. This suits request-style work where
+everything allocated (parsed JSON, generated strings, etc) dies together.
+
+    {
+        scoped_arena;
+        PValue v = json_parse_string(body);
+        ...
+    }  // everything is gone now
+
+When the arena is released, dispose functions are still called and reference
+arrays still unref their elements, so that any resources or heap objects they
+own are cleaned up properly.
+
+An object which must outlive the arena can be moved to the heap with `obj_promote`.
+
+Arenas may be nested, and an arena may be used inside an object pool; objects
+in the arena are not tracked by the pool. With `LLIB_THREADS`, an arena only
+collects the objects created by its own thread.
+
+Arena objects are not entered in the set of live objects, and are not counted
+by `obj_kount` or the allocation statistics and profiler. Instead every chunk is
+registered, with a bitmap of where its objects start, so `obj_refcount` can
+still tell exactly whether a pointer is one of ours. The arena only remembers
+the objects which have dispose functions and the reference arrays; the chunks
+themselves are freed without being walked.
+
+@module arena
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "obj.h"
+
+#ifdef LLIB_THREADS
+#ifdef _WIN32
+#include <windows.h>
+static SRWLOCK s_arena_lock = SRWLOCK_INIT;
+#define lock_arenas() AcquireSRWLockExclusive(&s_arena_lock)
+#define unlock_arenas() ReleaseSRWLockExclusive(&s_arena_lock)
+#else
+#include <pthread.h>
+static pthread_mutex_t s_arena_lock = PTHREAD_MUTEX_INITIALIZER;
+#define lock_arenas() pthread_mutex_lock(&s_arena_lock)
+#define unlock_arenas() pthread_mutex_unlock(&s_arena_lock)
+#endif
+#else
+#define lock_arenas()
+#define unlock_arenas()
+#endif
+
+extern LLIB_TLS void *(*_arena_alloc)(int size);
+void obj_release_(void *P);
+
+#define ARENA_CHUNK 65536
+
+typedef struct ArenaChunk_ ArenaChunk;
+typedef struct Arena_ Arena;
+
+struct ArenaChunk_ {
+    ArenaChunk *next;
+    Arena *arena;
+    char *data;
+    char *top;  // next free byte
+    char *end;
+    unsigned int *starts; // a bit for each 16 bytes of data, set where an object starts
+};
+
+struct Arena_ {
+    ArenaChunk *chunks;
+    Arena *prev;   // enclosing arena, if any
+    int chunk_size;
+    void **keep;   // objects which must be disposed with the arena
+    int nkeep, keep_cap;
+};
+
+typedef Arena* ObjArena;
+
+// Every allocation is prefixed with its size, so that `obj_promote` knows how
+// much to copy. This keeps the object header 8 bytes from a 16 byte boundary, as
+// with malloc.
+typedef struct ArenaPrefix_ {
+    unsigned int size;
+    unsigned int unused;
+} ArenaPrefix;
+
+#define ALIGN16(n) (((n) + 15) & ~15)
+
+static LLIB_TLS Arena *_arena;
+
+// The chunks of all arenas, in order of address, so that the chunk holding
+// a pointer can be found by binary search.
+static ArenaChunk **s_arena_chunks;
+static int s_narena_chunks, s_arena_chunks_cap;
+
+static void register_arena_chunk(ArenaChunk *ch) {
+    lock_arenas();
+    if (s_narena_chunks == s_arena_chunks_cap) {
+        s_arena_chunks_cap = s_arena_chunks_cap ? 2*s_arena_chunks_cap : 64;
+        s_arena_chunks = (ArenaChunk**)realloc(s_arena_chunks,s_arena_chunks_cap*sizeof(ArenaChunk*));
+    }
+    int i = s_narena_chunks;
+    for (; i > 0 && (uintptr_t)s_arena_chunks[i-1] > (uintptr_t)ch; i--)
+        s_arena_chunks[i] = s_arena_chunks[i-1];
+    s_arena_chunks[i] = ch;
+    obj_atomic_store_(&s_narena_chunks,s_narena_chunks + 1);
+    unlock_arenas();
+}
+
+// drop all the chunks of an arena from the registry, in one pass
+static void unregister_arena_chunks(Arena *a) {
+    lock_arenas();
+    int n = 0;
+    for (int i = 0; i < s_narena_chunks; i++) {
+        if (s_arena_chunks[i]->arena != a)
+            s_arena_chunks[n++] = s_arena_chunks[i];
+    }
+    obj_atomic_store_(&s_narena_chunks,n);
+    unlock_arenas();
+}
+
+static ArenaChunk *new_arena_chunk(Arena *a, int size) {
+    int words = (size/16 + 31)/32;
+    int head = ALIGN16(sizeof(ArenaChunk) + words*sizeof(unsigned int));
+    ArenaChunk *ch = (ArenaChunk*)malloc(head + size);
+    ch->arena = a;
+    ch->starts = (unsigned int*)(ch + 1);
+    memset(ch->starts,0,words*sizeof(unsigned int));
+    ch->data = ch->top = (char*)ch + head;
+    ch->end = ch->data + size;
+    register_arena_chunk(ch);
+    return ch;
+}
+
+static void *arena_alloc(int size) {
+    Arena *a = _arena;
+    int total = ALIGN16(size + sizeof(ArenaPrefix));
+    ArenaChunk *ch = a->chunks;
+    if (! ch || ch->top + total > ch->end) {
+        if (total > a->chunk_size/4) {
+            // big objects get their own chunk, behind the current one
+            ArenaChunk *big = new_arena_chunk(a,total);
+            if (ch) {
+                big->next = ch->next;
+                ch->next = big;
+            } else {
+                big->next = NULL;
+                a->chunks = big;
+            }
+            ch = big;
+        } else {
+            ch = new_arena_chunk(a,a->chunk_size);
+            ch->next = a->chunks;
+            a->chunks = ch;
+        }
+    }
+    ArenaPrefix *pre = (ArenaPrefix*)ch->top;
+    unsigned int g = (unsigned int)(ch->top - ch->data) >> 4;
+    pre->size = total;
+    ch->top += total;
+    obj_atomic_or_(&ch->starts[g >> 5],1u << (g & 31));
+    return pre + 1;
+}
+
+// does this pointer (an object header) lie in an arena chunk? If so, return
+// 1 if an object starts there and 0 otherwise; if not, return -1.
+int obj_arena_owns_(void *p) {
+    if (! obj_atomic_load_(&s_narena_chunks))
+        return -1;
+    uintptr_t x = (uintptr_t)p;
+    int res = -1;
+    lock_arenas();
+    int lo = 0, hi = s_narena_chunks;
+    while (lo < hi) { // the first chunk after p
+        int mid = (lo + hi)/2;
+        if ((uintptr_t)s_arena_chunks[mid] <= x)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    ArenaChunk *ch = lo > 0 ? s_arena_chunks[lo-1] : NULL;
+    if (ch && x < (uintptr_t)ch->end) {
+        // a header follows its prefix, on a 16 byte boundary
+        uintptr_t off = x - sizeof(ArenaPrefix) - (uintptr_t)ch->data;
+        res = 0;
+        if (x >= (uintptr_t)ch->data + sizeof(ArenaPrefix) && (off & 15) == 0) {
+            unsigned int g = (unsigned int)(off >> 4);
+            res = (obj_atomic_load_(&ch->starts[g >> 5]) >> (g & 31)) & 1;
+        }
+    }
+    unlock_arenas();
+    return res;
+}
+
+// the size available to an arena object, including its header
+int obj_arena_size_(ObjHeader *h) {
+    ArenaPrefix *pre = (ArenaPrefix*)h - 1;
+    return pre->size - sizeof(ArenaPrefix);
+}
+
+// called by obj.c for a new arena object which has a dispose function, or is
+// a reference array
+void obj_arena_keep_(void *P) {
+    Arena *a = _arena;
+    if (a->nkeep == a->keep_cap) {
+        a->keep_cap = a->keep_cap ? 2*a->keep_cap : 16;
+        a->keep = (void**)realloc(a->keep,a->keep_cap*sizeof(void*));
+    }
+    a->keep[a->nkeep++] = P;
+}
+
+static void arena_dispose(ObjArena *pa) {
+    Arena *a = *pa;
+    // any objects created by dispose functions must not go into this arena
+    _arena = a->prev;
+    _arena_alloc = _arena ? arena_alloc : NULL;
+    // the kept objects get their dispose functions called; the memory goes
+    // afterwards, since objects may refer to each other.
+    for (int i = 0; i < a->nkeep; i++)
+        obj_release_(a->keep[i]);
+    free(a->keep);
+    unregister_arena_chunks(a);
+    ArenaChunk *ch = a->chunks, *next;
+    while (ch) {
+        next = ch->next;
+        free(ch);
+        ch = next;
+    }
+    free(a);
+}
+
+/// create an arena which will hold all objects subsequently created by llib.
+// Returns an object which releases the arena when disposed. Use `scoped_arena`
+// for an arena which lasts until the end of the current block.
+// @int chunk_size size of the chunks (0 for default of 64K)
+// @within Arenas
+void *obj_arena(int chunk_size) {
+    Arena *a = (Arena*)calloc(1,sizeof(Arena));
+    a->chunk_size = chunk_size > 0 ? chunk_size : ARENA_CHUNK;
+    // the arena object itself does not live in the arena
+    _arena_alloc = NULL;
+    ObjArena *marker = obj_new(ObjArena,arena_dispose);
+    *marker = a;
+    a->prev = _arena;
+    _arena = a;
+    _arena_alloc = arena_alloc;
+    return (void*)marker;
+}
+
+/// declare an arena which is released at the end of the current block.
+// @macro scoped_arena
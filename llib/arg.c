@@ -198,6 +198,7 @@ static bool parse_flag(str_t arg, FlagEntry *pfd)
             if (is_arr) { // type name[](=split)
                 pfd->flags |= FlagIsArray;
                 *is_arr = '\0';
+                str_len(rest) = is_arr - rest;
                 // array split by separator, not by using multiple flag values
                 is_arr += 2;
                 if (*is_arr == '=')
@@ -537,7 +538,8 @@ ArgState *arg_parse_spec(PValue *flagspec)
         char *comment = strchr(spec,';');
         if (! comment)
             return parse_error(res,spec,"semi-colon required!");
-        *comment = '\0'; 
+        *comment = '\0';
+        str_len(spec) = comment - spec;
         // cool, spec is now the variable specification
         // now hunt for the comment
         comment++;
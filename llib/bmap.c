@@ -0,0 +1,649 @@
+/*
+* llib little C library
+* BSD licence
+* Copyright Steve Donovan, 2013
+*/
+
+/***
+### B-tree Maps.
+
+`Map` keeps one small node per key, so a big map is a great many
+scattered allocations, and a lookup follows a pointer for every comparison.
+A `BMap` is a _B+ tree_: each node packs up to 32 keys into one array,
+so a lookup searches a few contiguous arrays instead, and there are only
+two pointers of overhead for each entry. Values only live in the leaves,
+which are linked together in key order, so iteration is a walk along arrays.
+
+String keys are compared with strcmp, but each node also keeps the first
+eight bytes of its keys as a number; most comparisons are settled by these
+prefixes without following the key pointers at all. Other keys are ordered as
+integers.
+
+The kinds of keys and values, and who owns them, are the same as for maps
+and hash maps; `bmap_new_str_ptr` copies the string keys and leaves the values
+alone, `bmap_new_str_ref` also owns its values, and so forth.
+
+    BMap *m = bmap_new_str_ptr();
+    bmap_puti(m,"one",1);
+    bmap_puti(m,"two",2);
+    printf("%d\n",(int)bmap_geti(m,"two"));
+    char *key;
+    intptr_t val;
+    FOR_BMAP(key,val,m)
+        printf("%s %d\n",key,(int)val);
+
+`FOR_BMAP_FROM` starts at the first key which is not less than a given key.
+B-tree maps implement `Iterable` and `Accessor`.
+
+@module bmap
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "bmap.h"
+#include "interface.h"
+
+#define ORDER 32
+#define MIN_KEYS (ORDER/2)
+#define MAX_DEPTH 32
+
+typedef unsigned long long Prefix;
+
+struct BMapNode_ {
+    BMapNode *next;       // the next leaf, in key order
+    int n;                // number of keys
+    bool leaf;
+    void *keys[ORDER];
+    void *items[ORDER+1]; // values in a leaf, otherwise the n+1 children
+    Prefix prefix[ORDER]; // only allocated for string keys
+};
+
+// a key to look for, with its prefix worked out once
+typedef struct Probe_ {
+    void *key;
+    Prefix prefix;
+} Probe;
+
+static int t_bmap;
+static void init_bmap_interfaces();
+
+#define str_keys(m) ((m)->ktype & LIST_STR)
+
+// the first eight bytes as a big-endian number, so that prefixes order like strcmp
+static Prefix str_prefix(const char *s) {
+    Prefix p = 0;
+    for (int i = 0; i < 8; i++) {
+        p = (p << 8) | (unsigned char)*s;
+        if (*s)
+            ++s;
+    }
+    return p;
+}
+
+static void make_probe(BMap *m, void *key, Probe *p) {
+    p->key = key;
+    p->prefix = str_keys(m) ? str_prefix((const char*)key) : 0;
+}
+
+static BMapNode *new_node(BMap *m, bool leaf) {
+    size_t size = str_keys(m) ? sizeof(BMapNode) : offsetof(BMapNode,prefix);
+    BMapNode *nd = (BMapNode*)malloc(size);
+    nd->next = NULL;
+    nd->n = 0;
+    nd->leaf = leaf;
+    return nd;
+}
+
+static int key_compare(BMap *m, BMapNode *nd, int i, Probe *p) {
+    if (str_keys(m)) {
+        Prefix a = nd->prefix[i];
+        if (a != p->prefix)
+            return a < p->prefix ? -1 : 1;
+        return strcmp((const char*)nd->keys[i],(const char*)p->key);
+    } else {
+        intptr_t a = (intptr_t)nd->keys[i], b = (intptr_t)p->key;
+        return a < b ? -1 : a > b;
+    }
+}
+
+// first key not less than the probe; with `upper`, first key greater than it
+static int node_search(BMap *m, BMapNode *nd, Probe *p, bool upper) {
+    int lo = 0, hi = nd->n;
+    while (lo < hi) {
+        int mid = (lo + hi)/2;
+        int c = key_compare(m,nd,mid,p);
+        if (c < 0 || (upper && c == 0))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// keys and their prefixes always move together
+static void move_keys(BMap *m, BMapNode *dest, int di, BMapNode *src, int si, int n) {
+    memmove(&dest->keys[di],&src->keys[si],n*sizeof(void*));
+    if (str_keys(m))
+        memmove(&dest->prefix[di],&src->prefix[si],n*sizeof(Prefix));
+}
+
+static void move_items(BMapNode *dest, int di, BMapNode *src, int si, int n) {
+    memmove(&dest->items[di],&src->items[si],n*sizeof(void*));
+}
+
+static void set_key(BMap *m, BMapNode *nd, int i, void *key, Prefix prefix) {
+    nd->keys[i] = key;
+    if (str_keys(m))
+        nd->prefix[i] = prefix;
+}
+
+static void copy_key(BMap *m, BMapNode *dest, int di, BMapNode *src, int si) {
+    set_key(m,dest,di,src->keys[si],str_keys(m) ? src->prefix[si] : 0);
+}
+
+// separators in inner nodes are their own copies of string keys,
+// since the leaf key they came from may be removed
+static void set_separator(BMap *m, BMapNode *nd, int i, BMapNode *src, int si) {
+    if (str_keys(m)) {
+        obj_unref(nd->keys[i]);
+        nd->keys[i] = str_new((const char*)src->keys[si]);
+        nd->prefix[i] = src->prefix[si];
+    } else {
+        nd->keys[i] = src->keys[si];
+    }
+}
+
+static void free_nodes(BMap *m, BMapNode *nd) {
+    if (nd->leaf) {
+        for (int i = 0; i < nd->n; i++) {
+            if (m->ktype & LIST_REF)
+                obj_unref(nd->keys[i]);
+            if (m->vtype & LIST_REF)
+                obj_unref(nd->items[i]);
+        }
+    } else {
+        for (int i = 0; i < nd->n; i++) {
+            if (str_keys(m))
+                obj_unref(nd->keys[i]);
+        }
+        for (int i = 0; i <= nd->n; i++)
+            free_nodes(m,(BMapNode*)nd->items[i]);
+    }
+    free(nd);
+}
+
+/// clear all entries out of a B-tree map.
+// Owned keys and values are released.
+void bmap_clear(BMap *m) {
+    if (m->root)
+        free_nodes(m,m->root);
+    m->root = m->first = NULL;
+    m->size = 0;
+}
+
+/// Making New B-tree Maps
+// @section new
+
+/// make a new B-tree map.
+// @int ktype kind of key, `LIST_PTR` or `LIST_STRING`
+// @int vtype kind of value, `LIST_PTR`, `LIST_REF` or `LIST_STRING`
+BMap *bmap_new(int ktype, int vtype) {
+    if (! t_bmap) {
+        t_bmap = obj_new_type(BMap,bmap_clear);
+        init_bmap_interfaces();
+    }
+    BMap *m = (BMap*)obj_new_from_type(t_bmap);
+    m->root = m->first = NULL;
+    m->size = 0;
+    m->ktype = ktype;
+    m->vtype = vtype;
+    return m;
+}
+
+/// make a new B-tree map with string keys and pointer values.
+// The keys are copied, and owned by the map.
+BMap *bmap_new_str_ptr() {
+    return bmap_new(LIST_STRING,LIST_PTR);
+}
+
+/// make a new B-tree map with string keys and refcounted values.
+BMap *bmap_new_str_ref() {
+    return bmap_new(LIST_STRING,LIST_REF);
+}
+
+/// make a new B-tree map with string keys and string values.
+BMap *bmap_new_str_str() {
+    return bmap_new(LIST_STRING,LIST_STRING);
+}
+
+/// make a new B-tree map with pointer keys and pointer values.
+// Keys are ordered as integers up to intptr_t size.
+BMap *bmap_new_ptr_ptr() {
+    return bmap_new(LIST_PTR,LIST_PTR);
+}
+
+/// make a new B-tree map with pointer keys and refcounted values.
+BMap *bmap_new_ptr_ref() {
+    return bmap_new(LIST_PTR,LIST_REF);
+}
+
+/// make a new B-tree map with pointer keys and string values.
+BMap *bmap_new_ptr_str() {
+    return bmap_new(LIST_PTR,LIST_STRING);
+}
+
+/// is this object a B-tree map?
+bool bmap_object(void *obj) {
+    return obj_type_index(obj) == t_bmap;
+}
+
+/// Insertion, removal and retrieval
+// @section put
+
+// the leaf which would hold the key, with the way down to it
+static BMapNode *find_leaf(BMap *m, Probe *p, BMapNode **path, int *slots, int *pdepth) {
+    BMapNode *nd = m->root;
+    int depth = 0;
+    while (! nd->leaf) {
+        int i = node_search(m,nd,p,true);
+        if (path) {
+            path[depth] = nd;
+            slots[depth] = i;
+        }
+        ++depth;
+        nd = (BMapNode*)nd->items[i];
+    }
+    if (pdepth)
+        *pdepth = depth;
+    return nd;
+}
+
+// a new separator and right-hand node go into the parents, splitting them as needed
+static void insert_up(BMap *m, BMapNode **path, int *slots, int depth,
+    void *sep, Prefix prefix, BMapNode *right)
+{
+    void *keys[ORDER+1], *kids[ORDER+2];
+    Prefix prefixes[ORDER+1];
+    while (depth > 0) {
+        BMapNode *nd = path[--depth];
+        int i = slots[depth];
+        if (nd->n < ORDER) {
+            move_keys(m,nd,i+1,nd,i,nd->n - i);
+            move_items(nd,i+2,nd,i+1,nd->n - i);
+            set_key(m,nd,i,sep,prefix);
+            nd->items[i+1] = right;
+            ++nd->n;
+            return;
+        }
+        // a full node: lay out all the keys and children, and share them out
+        memcpy(keys,nd->keys,i*sizeof(void*));
+        keys[i] = sep;
+        memcpy(keys+i+1,nd->keys+i,(ORDER-i)*sizeof(void*));
+        memcpy(kids,nd->items,(i+1)*sizeof(void*));
+        kids[i+1] = right;
+        memcpy(kids+i+2,nd->items+i+1,(ORDER-i)*sizeof(void*));
+        if (str_keys(m)) {
+            memcpy(prefixes,nd->prefix,i*sizeof(Prefix));
+            prefixes[i] = prefix;
+            memcpy(prefixes+i+1,nd->prefix+i,(ORDER-i)*sizeof(Prefix));
+        }
+        int mid = (ORDER+1)/2;
+        right = new_node(m,false);
+        nd->n = mid;
+        right->n = ORDER - mid;
+        memcpy(nd->keys,keys,mid*sizeof(void*));
+        memcpy(nd->items,kids,(mid+1)*sizeof(void*));
+        memcpy(right->keys,keys+mid+1,right->n*sizeof(void*));
+        memcpy(right->items,kids+mid+1,(right->n+1)*sizeof(void*));
+        if (str_keys(m)) {
+            memcpy(nd->prefix,prefixes,mid*sizeof(Prefix));
+            memcpy(right->prefix,prefixes+mid+1,right->n*sizeof(Prefix));
+            prefix = prefixes[mid];
+        }
+        sep = keys[mid];
+    }
+    BMapNode *root = new_node(m,false);
+    root->n = 1;
+    set_key(m,root,0,sep,prefix);
+    root->items[0] = m->root;
+    root->items[1] = right;
+    m->root = root;
+}
+
+static void **put_entry(BMap *m, void *key, bool *added) {
+    BMapNode *path[MAX_DEPTH];
+    int slots[MAX_DEPTH], depth;
+    Probe p;
+    make_probe(m,key,&p);
+    if (! m->root)
+        m->root = m->first = new_node(m,true);
+    BMapNode *nd = find_leaf(m,&p,path,slots,&depth);
+    int i = node_search(m,nd,&p,false);
+    if (i < nd->n && key_compare(m,nd,i,&p) == 0) {
+        // like maps, we take over a refcounted string key, so let it go
+        if (str_keys(m) && key != nd->keys[i] && obj_refcount(key) != -1)
+            obj_unref(key);
+        *added = false;
+        return &nd->items[i];
+    }
+    if (str_keys(m))
+        key = str_cpy((char*)key);
+    ++m->size;
+    *added = true;
+    BMapNode *target = nd;
+    if (nd->n == ORDER) { // split the leaf, and the new key goes into one half
+        BMapNode *right = new_node(m,true);
+        int half = ORDER/2;
+        right->n = ORDER - half;
+        move_keys(m,right,0,nd,half,right->n);
+        move_items(right,0,nd,half,right->n);
+        nd->n = half;
+        right->next = nd->next;
+        nd->next = right;
+        if (i > half) {
+            target = right;
+            i -= half;
+        }
+        void *sep = right->keys[0];
+        insert_up(m,path,slots,depth,str_keys(m) ? str_new((char*)sep) : sep,
+            str_keys(m) ? right->prefix[0] : 0,right);
+    }
+    move_keys(m,target,i+1,target,i,target->n - i);
+    move_items(target,i+1,target,i,target->n - i);
+    set_key(m,target,i,key,p.prefix);
+    target->items[i] = NULL;
+    ++target->n;
+    return &target->items[i];
+}
+
+/// insert a value using a key.
+// As with maps, string keys and values are copied unless they are
+// refcounted, in which case the map takes them over. A refcounted value
+// which is replaced is released.
+// @return `true` if the key was new
+bool bmap_put(BMap *m, void *key, void *value) {
+    bool added;
+    void **pval = put_entry(m,key,&added);
+    if (m->vtype == LIST_STRING)
+        value = str_cpy((char*)value);
+    if (! added && m->vtype & LIST_REF && *pval != value)
+        obj_unref(*pval);
+    *pval = value;
+    return added;
+}
+
+/// a pointer to the value for this key, adding the key if needed.
+// A new key has a NULL value. The pointer is only good until the map
+// is next changed.
+void **bmap_put_ptr(BMap *m, void *key) {
+    bool added;
+    return put_entry(m,key,&added);
+}
+
+/// insert an array of key/value pairs.
+void bmap_put_keyvalues(BMap *m, MapKeyValue *mkv) {
+    for(; mkv->key; ++mkv) {
+        bmap_put(m,mkv->key,mkv->value);
+    }
+}
+
+// the leaf and index of a key, or NULL
+static BMapNode *find_key(BMap *m, void *key, int *pi) {
+    if (! m->root)
+        return NULL;
+    Probe p;
+    make_probe(m,key,&p);
+    BMapNode *nd = find_leaf(m,&p,NULL,NULL,NULL);
+    int i = node_search(m,nd,&p,false);
+    if (i < nd->n && key_compare(m,nd,i,&p) == 0) {
+        *pi = i;
+        return nd;
+    }
+    return NULL;
+}
+
+/// get the value associated with a key.
+// @return the value, or NULL if not found, or the value was NULL.
+void *bmap_get(BMap *m, void *key) {
+    int i;
+    BMapNode *nd = find_key(m,key,&i);
+    return nd ? nd->items[i] : NULL;
+}
+
+/// get an integer value from a B-tree map.
+// @tparam BMap* m
+// @param key cast to void*
+// @treturn int
+// @function bmap_geti
+
+/// put an integer value into a B-tree map.
+// @tparam BMap* m
+// @param key cast to void*
+// @tparam value cast to void*
+// @function bmap_puti
+
+/// does the B-tree map contain this key?
+// @treturn bool `true` if the key is found, even if the value was NULL.
+bool bmap_contains(BMap *m, void *key) {
+    int i;
+    return find_key(m,key,&i) != NULL;
+}
+
+static void remove_separator(BMap *m, BMapNode *nd, int i) {
+    if (str_keys(m))
+        obj_unref(nd->keys[i]);
+    move_keys(m,nd,i,nd,i+1,nd->n - i - 1);
+    move_items(nd,i+1,nd,i+2,nd->n - i - 1);
+    --nd->n;
+}
+
+// an underfull node borrows a key from a neighbour, or is merged with it
+static void fix_underflow(BMap *m, BMapNode *nd, BMapNode **path, int *slots, int depth) {
+    while (depth > 0 && nd->n < MIN_KEYS) {
+        BMapNode *parent = path[depth-1];
+        int ci = slots[depth-1];
+        BMapNode *left = ci > 0 ? (BMapNode*)parent->items[ci-1] : NULL;
+        BMapNode *right = ci < parent->n ? (BMapNode*)parent->items[ci+1] : NULL;
+        if (left && left->n > MIN_KEYS) {
+            move_keys(m,nd,1,nd,0,nd->n);
+            if (nd->leaf) {
+                move_items(nd,1,nd,0,nd->n);
+                copy_key(m,nd,0,left,left->n-1);
+                nd->items[0] = left->items[left->n-1];
+                set_separator(m,parent,ci-1,nd,0);
+            } else {
+                move_items(nd,1,nd,0,nd->n+1);
+                copy_key(m,nd,0,parent,ci-1);
+                nd->items[0] = left->items[left->n];
+                copy_key(m,parent,ci-1,left,left->n-1);
+            }
+            --left->n;
+            ++nd->n;
+            return;
+        }
+        if (right && right->n > MIN_KEYS) {
+            if (nd->leaf) {
+                copy_key(m,nd,nd->n,right,0);
+                nd->items[nd->n] = right->items[0];
+                move_keys(m,right,0,right,1,right->n-1);
+                move_items(right,0,right,1,right->n-1);
+                set_separator(m,parent,ci,right,0);
+            } else {
+                copy_key(m,nd,nd->n,parent,ci);
+                nd->items[nd->n+1] = right->items[0];
+                copy_key(m,parent,ci,right,0);
+                move_keys(m,right,0,right,1,right->n-1);
+                move_items(right,0,right,1,right->n);
+            }
+            --right->n;
+            ++nd->n;
+            return;
+        }
+        // merge with a neighbour; the right-hand node of the pair goes
+        if (left) {
+            right = nd;
+            nd = left;
+            --ci;
+        }
+        if (nd->leaf) {
+            move_keys(m,nd,nd->n,right,0,right->n);
+            move_items(nd,nd->n,right,0,right->n);
+            nd->n += right->n;
+            nd->next = right->next;
+            remove_separator(m,parent,ci);
+        } else {
+            // the separator comes down between the two sets of keys
+            copy_key(m,nd,nd->n,parent,ci);
+            move_keys(m,nd,nd->n+1,right,0,right->n);
+            move_items(nd,nd->n+1,right,0,right->n+1);
+            nd->n += right->n + 1;
+            move_keys(m,parent,ci,parent,ci+1,parent->n - ci - 1);
+            move_items(parent,ci+1,parent,ci+2,parent->n - ci - 1);
+            --parent->n;
+        }
+        free(right);
+        nd = parent;
+        --depth;
+    }
+    BMapNode *root = m->root;
+    if (! root->leaf && root->n == 0) {
+        m->root = (BMapNode*)root->items[0];
+        free(root);
+    } else if (root->leaf && root->n == 0) {
+        free(root);
+        m->root = m->first = NULL;
+    }
+}
+
+/// remove key/value, freeing any allocated memory.
+// @return true if the key was found.
+bool bmap_delete(BMap *m, void *key) {
+    if (! m->root)
+        return false;
+    BMapNode *path[MAX_DEPTH];
+    int slots[MAX_DEPTH], depth;
+    Probe p;
+    make_probe(m,key,&p);
+    BMapNode *nd = find_leaf(m,&p,path,slots,&depth);
+    int i = node_search(m,nd,&p,false);
+    if (i == nd->n || key_compare(m,nd,i,&p) != 0)
+        return false;
+    if (m->ktype & LIST_REF)
+        obj_unref(nd->keys[i]);
+    if (m->vtype & LIST_REF)
+        obj_unref(nd->items[i]);
+    move_keys(m,nd,i,nd,i+1,nd->n - i - 1);
+    move_items(nd,i,nd,i+1,nd->n - i - 1);
+    --nd->n;
+    --m->size;
+    fix_underflow(m,nd,path,slots,depth);
+    return true;
+}
+
+/// Iterating over B-tree maps
+// @section iter
+
+/// start iterating over a B-tree map, in key order.
+BMapIter bmap_iter(BMap *m) {
+    BMapIter it;
+    it.node = m->first;
+    it.i = 0;
+    return it;
+}
+
+/// start iterating at the first key which is not less than `key`.
+BMapIter bmap_iter_from(BMap *m, void *key) {
+    BMapIter it;
+    it.node = NULL;
+    it.i = 0;
+    if (m->root) {
+        Probe p;
+        make_probe(m,key,&p);
+        it.node = find_leaf(m,&p,NULL,NULL,NULL);
+        it.i = node_search(m,it.node,&p,false);
+    }
+    return it;
+}
+
+/// the next entry in a B-tree map.
+// @param it the iterator
+// @param pkey pointer to a key variable
+// @param pvalue pointer to a value variable
+// @return `false` if there are no more entries
+bool bmap_next(BMapIter *it, void *pkey, void *pvalue) {
+    while (it->node && it->i == it->node->n) {
+        it->node = it->node->next;
+        it->i = 0;
+    }
+    if (! it->node)
+        return false;
+    *(void**)pkey = it->node->keys[it->i];
+    *(void**)pvalue = it->node->items[it->i];
+    ++it->i;
+    return true;
+}
+
+/// iterate over a B-tree map in key order.
+// @param k variable for key
+// @param v variable for value
+// @param m the B-tree map
+// @macro FOR_BMAP
+
+/// iterate over a B-tree map, starting at a key.
+// @param k variable for key
+// @param v variable for value
+// @param m the B-tree map
+// @param lo the first key, or the key before which to start
+// @macro FOR_BMAP_FROM
+
+/// Get the key/value pairs of a B-tree map as an array, in key order.
+MapKeyValue *bmap_to_array(BMap *m) {
+    MapKeyValue *res = array_new(MapKeyValue,m->size), *kp = res;
+    void *key, *value;
+    FOR_BMAP(key,value,m) {
+        kp->key = key;
+        kp->value = value;
+        ++kp;
+    }
+    return res;
+}
+
+// B-tree maps are Iterable; `next` gives keys, `nextpair` keys and values
+typedef struct BMapIterator_ {
+    bool (*next)(Iterator *iter, void *pval);
+    bool (*nextpair)(Iterator *iter, void *pkey, void *pval);
+    int len;
+    BMapIter it;
+} BMapIterator;
+
+static bool iterator_bmap_nextpair(Iterator *iter, void *pkey, void *pval) {
+    return bmap_next(&((BMapIterator*)iter)->it,pkey,pval);
+}
+
+static bool iterator_bmap_next(Iterator *iter, void *pval) {
+    void *pnone;
+    return iterator_bmap_nextpair(iter,pval,(void*)&pnone);
+}
+
+static Iterator* iterator_bmap_init(const void *o) {
+    BMapIterator *iter = obj_new(BMapIterator,NULL);
+    iter->it = bmap_iter((BMap*)o);
+    iter->next = iterator_bmap_next;
+    iter->nextpair = iterator_bmap_nextpair;
+    iter->len = bmap_size((BMap*)o);
+    return (Iterator*)iter;
+}
+
+static Iterable i_bmap = {
+    iterator_bmap_init
+};
+
+static Accessor i_bmap_lookup = {
+    (ObjLookup)bmap_get
+};
+
+static void init_bmap_interfaces() {
+    interface_add(interface_typeof(Iterable),t_bmap,&i_bmap);
+    interface_add(interface_typeof(Accessor),t_bmap,&i_bmap_lookup);
+}
@@ -0,0 +1,60 @@
+/*
+* llib little C library
+* BSD licence
+* Copyright Steve Donovan, 2013
+*/
+
+#ifndef _LLIB_BMAP_H
+#define _LLIB_BMAP_H
+
+#include "list.h"
+
+typedef struct BMapNode_ BMapNode;
+
+typedef struct BMap_ {
+    BMapNode *root;
+    BMapNode *first;   // the leftmost leaf
+    int size;
+    int ktype, vtype;  // LIST_PTR, LIST_REF or LIST_STRING
+} BMap;
+
+// a position in a B-tree map, for iterating
+typedef struct BMapIter_ {
+    BMapNode *node;
+    int i;
+} BMapIter;
+
+#define bmap_size(m) ((m)->size)
+
+#define bmap_geti(m,k) ((intptr_t)bmap_get(m,(void*)(k)))
+#define bmap_puti(m,k,v) bmap_put(m,(void*)(k),(void*)(v))
+#define bmap_gets(m,key) bmap_get(m,(void*)key)
+#define bmap_puts(m,key,val) bmap_put(m,(void*)key,(void*)val)
+
+BMap *bmap_new(int ktype, int vtype);
+BMap *bmap_new_str_ptr();
+BMap *bmap_new_str_ref();
+BMap *bmap_new_str_str();
+BMap *bmap_new_ptr_ptr();
+BMap *bmap_new_ptr_ref();
+BMap *bmap_new_ptr_str();
+
+bool bmap_object(void *obj);
+
+void bmap_clear(BMap *m);
+bool bmap_put(BMap *m, void *key, void *value);
+void **bmap_put_ptr(BMap *m, void *key);
+void bmap_put_keyvalues(BMap *m, MapKeyValue *mkv);
+void *bmap_get(BMap *m, void *key);
+bool bmap_contains(BMap *m, void *key);
+bool bmap_delete(BMap *m, void *key);
+BMapIter bmap_iter(BMap *m);
+BMapIter bmap_iter_from(BMap *m, void *key);
+bool bmap_next(BMapIter *it, void *pkey, void *pvalue);
+MapKeyValue *bmap_to_array(BMap *m);
+
+#define FOR_BMAP(k,v,m) for (BMapIter it_##k = bmap_iter(m); bmap_next(&it_##k,&k,&v); )
+#define FOR_BMAP_FROM(k,v,m,lo) for (BMapIter it_##k = bmap_iter_from(m,(void*)(lo)); \
+bmap_next(&it_##k,&k,&v); )
+
+#endif
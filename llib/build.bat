@@ -1,11 +1,17 @@
 cl /nologo -c /O2 /WX /TP /D_CRT_SECURE_NO_DEPRECATE /DNDEBUG   obj.c
+cl /nologo -c /O2 /WX /TP /D_CRT_SECURE_NO_DEPRECATE /DNDEBUG   slab.c
+cl /nologo -c /O2 /WX /TP /D_CRT_SECURE_NO_DEPRECATE /DNDEBUG   arena.c
+cl /nologo -c /O2 /WX /TP /D_CRT_SECURE_NO_DEPRECATE /DNDEBUG   profile.c
 cl /nologo -c /O2 /WX /TP /D_CRT_SECURE_NO_DEPRECATE /DNDEBUG   sort.c
 cl /nologo -c /O2 /WX /TP /D_CRT_SECURE_NO_DEPRECATE /DNDEBUG   list.c
 cl /nologo -c /O2 /WX /TP /D_CRT_SECURE_NO_DEPRECATE /DNDEBUG   file.c
 cl /nologo -c /O2 /WX /TP /D_CRT_SECURE_NO_DEPRECATE /DNDEBUG   scan.c
 cl /nologo -c /O2 /WX /TP /D_CRT_SECURE_NO_DEPRECATE /DNDEBUG   map.c
+cl /nologo -c /O2 /WX /TP /D_CRT_SECURE_NO_DEPRECATE /DNDEBUG   hmap.c
+cl /nologo -c /O2 /WX /TP /D_CRT_SECURE_NO_DEPRECATE /DNDEBUG   bmap.c
+cl /nologo -c /O2 /WX /TP /D_CRT_SECURE_NO_DEPRECATE /DNDEBUG   fmap.c
 cl /nologo -c /O2 /WX /TP /D_CRT_SECURE_NO_DEPRECATE /DNDEBUG   str.c
 cl /nologo -c /O2 /WX /TP /D_CRT_SECURE_NO_DEPRECATE /DNDEBUG   template.c
 cl /nologo -c /O2 /WX /TP /D_CRT_SECURE_NO_DEPRECATE /DNDEBUG   value.c
 cl /nologo -c /O2 /WX /TP /D_CRT_SECURE_NO_DEPRECATE /DNDEBUG   json.c
-lib /nologo obj.obj sort.obj list.obj file.obj scan.obj map.obj str.obj template.obj value.obj json.obj /OUT:llib_static.lib
+lib /nologo obj.obj slab.obj arena.obj profile.obj sort.obj list.obj file.obj scan.obj map.obj hmap.obj bmap.obj fmap.obj str.obj template.obj value.obj json.obj /OUT:llib_static.lib
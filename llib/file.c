@@ -62,12 +62,11 @@ See `test-file.c`
 #define MAX_PATH 256
 
 static void strip_eol(char *buff) {
-    int last = strlen(buff)-1;
-    if (buff[last] == '\n')
-        buff[last] = '\0';
-    --last;
-    if (buff[last] == '\r')
-        buff[last] = '\0';
+    int len = strlen(buff);
+    if (len > 0 && buff[len-1] == '\n')
+        buff[--len] = '\0';
+    if (len > 0 && buff[len-1] == '\r')
+        buff[--len] = '\0';
 }
 
 /// does the path exist and is accessible?
@@ -149,9 +148,13 @@ static char* read_all(FILE *fp, bool text) {
     char *res = str_new_size(sz);
     int n = fread(res,1,sz,fp);
     if (text) {
+        if (n > 0 && res[n-1] == '\n')
+            --n;
+        if (n > 0 && res[n-1] == '\r')
+            --n;
         res[n] = '\0';
-        strip_eol(res);
     }
+    str_len(res) = n;
     fclose(fp);
     return res;
 }
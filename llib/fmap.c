@@ -0,0 +1,358 @@
+/*
+* llib little C library
+* BSD licence
+* Copyright Steve Donovan, 2013
+*/
+
+/***
+### Flat Maps.
+
+Many tables are built once and then only read: MIME types, configuration
+keys, command names. A flat map is a sorted array of keys built from an
+array of `MapKeyValue` pairs, and cannot be changed afterwards.
+
+The keys are not kept in plain sorted order but in _Eytzinger_ order, which
+is the order of a breadth-first walk of the balanced binary tree over the
+sorted keys. Then the two keys which may be visited next are always next to
+each other, the first few levels of the search stay in cache, and the next
+levels can be fetched before they are needed. The search step does not branch
+on the comparison, so it does not suffer mispredictions either.
+String keys also have their first eight bytes kept as a number, as with `BMap`,
+so that most comparisons do not touch the strings.
+
+String keys are copied into a single block owned by the map; string values
+with `fmap_new_str_str` are copied as refcounted strings, so they are
+known to be strings by JSON and other consumers. The pairs need not be sorted, and if a key
+is repeated the last value is used.
+
+    MapKeyValue mime[] = {
+        {"html","text/html"},
+        {"css","text/css"},
+        {NULL,NULL}
+    };
+    FMap *m = fmap_new_str_ptr(mime,-1);
+    printf("%s\n",(char*)fmap_gets(m,"css"));
+
+An existing map can be turned into a flat map with `fmap_from_map`.
+Flat maps implement `Iterable` (in key order) and `Accessor`, so templates
+and JSON can use them directly.
+
+@module fmap
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "fmap.h"
+#include "interface.h"
+
+#ifdef __GNUC__
+#define prefetch(p) __builtin_prefetch(p)
+#else
+#define prefetch(p)
+#endif
+
+typedef unsigned long long Prefix;
+
+// a pair remembers where it came from, so that the last of equal keys wins
+typedef struct FPair_ {
+    void *key;
+    void *value;
+    int pos;
+} FPair;
+
+static int t_fmap;
+static void init_fmap_interfaces();
+
+#define str_keys(m) ((m)->ktype & LIST_STR)
+
+// the first eight bytes as a big-endian number, so that prefixes order like strcmp
+static Prefix key_prefix(const char *s) {
+    Prefix p = 0;
+    for (int i = 0; i < 8; i++) {
+        p = (p << 8) | (unsigned char)*s;
+        if (*s)
+            ++s;
+    }
+    return p;
+}
+
+static void fmap_dispose(FMap *m) {
+    if (m->vtype & LIST_REF) {
+        for (int k = 1; k <= m->size; k++)
+            obj_unref(m->values[k]);
+    }
+    free(m->keys);
+    free(m->values);
+    free(m->prefix);
+    free(m->strings);
+}
+
+static int pair_compare_str(const void *a, const void *b) {
+    const FPair *pa = (const FPair*)a, *pb = (const FPair*)b;
+    int res = strcmp((const char*)pa->key,(const char*)pb->key);
+    return res ? res : pa->pos - pb->pos;
+}
+
+static int pair_compare_ptr(const void *a, const void *b) {
+    const FPair *pa = (const FPair*)a, *pb = (const FPair*)b;
+    intptr_t ka = (intptr_t)pa->key, kb = (intptr_t)pb->key;
+    if (ka != kb)
+        return ka < kb ? -1 : 1;
+    return pa->pos - pb->pos;
+}
+
+// copy a string into the map's block
+static char *pack_string(char **pp, const char *s) {
+    char *res = *pp;
+    size_t len = strlen(s) + 1;
+    memcpy(res,s,len);
+    *pp += len;
+    return res;
+}
+
+// the in-order walk of the implicit tree at k visits the sorted pairs in turn
+static int layout(FMap *m, FPair *sorted, int i, int k) {
+    if (k <= m->size) {
+        i = layout(m,sorted,i,2*k);
+        m->keys[k] = sorted[i].key;
+        m->values[k] = sorted[i].value;
+        if (str_keys(m))
+            m->prefix[k] = key_prefix((const char*)sorted[i].key);
+        ++i;
+        i = layout(m,sorted,i,2*k + 1);
+    }
+    return i;
+}
+
+/// Making New Flat Maps
+// @section new
+
+/// make a new flat map from key/value pairs.
+// @param mkv array of pairs
+// @int n number of pairs, or -1 if the array ends with a NULL key
+// @int ktype kind of key, `LIST_PTR` or `LIST_STRING`
+// @int vtype kind of value; `LIST_PTR` values are kept as they are,
+// refcounted `LIST_REF` values are shared, and `LIST_STRING` values are copied
+// unless they are already refcounted.
+FMap *fmap_new(MapKeyValue *mkv, int n, int ktype, int vtype) {
+    if (! t_fmap) {
+        t_fmap = obj_new_type(FMap,fmap_dispose);
+        init_fmap_interfaces();
+    }
+    if (n < 0)
+        for (n = 0; mkv[n].key; n++) ;
+    FMap *m = (FMap*)obj_new_from_type(t_fmap);
+    m->ktype = ktype;
+    m->vtype = vtype;
+
+    FPair *pairs = (FPair*)malloc((n + 1)*sizeof(FPair));
+    for (int i = 0; i < n; i++) {
+        pairs[i].key = mkv[i].key;
+        pairs[i].value = mkv[i].value;
+        pairs[i].pos = i;
+    }
+    qsort(pairs,n,sizeof(FPair),str_keys(m) ? pair_compare_str : pair_compare_ptr);
+    // keep the last of any run of equal keys
+    int size = 0;
+    for (int i = 0; i < n; i++) {
+        if (i + 1 < n && (str_keys(m)
+            ? strcmp((const char*)pairs[i].key,(const char*)pairs[i+1].key) == 0
+            : pairs[i].key == pairs[i+1].key))
+            continue;
+        pairs[size++] = pairs[i];
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < size; i++) {
+        if (str_keys(m))
+            total += strlen((const char*)pairs[i].key) + 1;
+    }
+    m->strings = total ? (char*)malloc(total) : NULL;
+    char *p = m->strings;
+    for (int i = 0; i < size; i++) {
+        if (str_keys(m))
+            pairs[i].key = pack_string(&p,(const char*)pairs[i].key);
+        if (! pairs[i].value)
+            continue;
+        if (vtype == LIST_REF || (vtype == LIST_STRING && obj_refcount(pairs[i].value) != -1))
+            obj_incr_(pairs[i].value);
+        else if (vtype == LIST_STRING)
+            pairs[i].value = str_new((const char*)pairs[i].value);
+    }
+
+    m->size = size;
+    m->keys = (void**)malloc((size + 1)*sizeof(void*));
+    m->values = (void**)malloc((size + 1)*sizeof(void*));
+    m->prefix = str_keys(m) ? (Prefix*)malloc((size + 1)*sizeof(Prefix)) : NULL;
+    layout(m,pairs,0,1);
+    free(pairs);
+    return m;
+}
+
+/// make a new flat map with string keys and pointer values.
+FMap *fmap_new_str_ptr(MapKeyValue *mkv, int n) {
+    return fmap_new(mkv,n,LIST_STRING,LIST_PTR);
+}
+
+/// make a new flat map with string keys and string values.
+FMap *fmap_new_str_str(MapKeyValue *mkv, int n) {
+    return fmap_new(mkv,n,LIST_STRING,LIST_STRING);
+}
+
+/// make a new flat map with pointer keys and pointer values.
+// Keys are ordered as integers up to intptr_t size.
+FMap *fmap_new_ptr_ptr(MapKeyValue *mkv, int n) {
+    return fmap_new(mkv,n,LIST_PTR,LIST_PTR);
+}
+
+/// make a flat map with the same entries as a map.
+// String keys are copied, and values owned by the map are shared, so the
+// flat map does not depend on the map afterwards.
+FMap *fmap_from_map(Map *m) {
+    MapKeyValue *pkv = map_to_array(m);
+    FMap *res = fmap_new(pkv,array_len(pkv),(m->flags & LIST_STR) ? LIST_STRING : LIST_PTR,
+        map_owns_values(m) ? LIST_REF : LIST_PTR);
+    unref(pkv);
+    return res;
+}
+
+/// is this object a flat map?
+bool fmap_object(void *obj) {
+    return obj_type_index(obj) == t_fmap;
+}
+
+/// Retrieval
+// @section get
+
+// a left child is visited after its subtree, so drop the right turns taken below it
+static int lower_bound_index(unsigned int k) {
+#ifdef __GNUC__
+    return k >> (__builtin_ctz(~k) + 1);
+#else
+    while (k & 1)
+        k >>= 1;
+    return k >> 1;
+#endif
+}
+
+// index of the key, or zero. The search descends one level per step; the
+// eight keys three levels further down share a cache line, which is fetched early
+static int find_index(FMap *m, void *key) {
+    unsigned int k = 1, n = (unsigned int)m->size;
+    if (str_keys(m)) {
+        Prefix px = key_prefix((const char*)key);
+        while (k <= n) {
+            prefetch(m->prefix + 8*k);
+            Prefix pk = m->prefix[k];
+            bool less = pk < px || (pk == px && strcmp((const char*)m->keys[k],(const char*)key) < 0);
+            k = 2*k + less;
+        }
+        k = lower_bound_index(k);
+        if (k && m->prefix[k] == px && strcmp((const char*)m->keys[k],(const char*)key) == 0)
+            return k;
+    } else {
+        intptr_t x = (intptr_t)key;
+        while (k <= n) {
+            prefetch(m->keys + 8*k);
+            k = 2*k + ((intptr_t)m->keys[k] < x);
+        }
+        k = lower_bound_index(k);
+        if (k && m->keys[k] == key)
+            return k;
+    }
+    return 0;
+}
+
+/// get the value associated with a key.
+// @return the value, or NULL if not found, or the value was NULL.
+void *fmap_get(FMap *m, void *key) {
+    int k = find_index(m,key);
+    return k ? m->values[k] : NULL;
+}
+
+/// get an integer value from a flat map.
+// @tparam FMap* m
+// @param key cast to void*
+// @treturn int
+// @function fmap_geti
+
+/// does the flat map contain this key?
+// @treturn bool `true` if the key is found, even if the value was NULL.
+bool fmap_contains(FMap *m, void *key) {
+    return find_index(m,key) != 0;
+}
+
+/// Iterating over flat maps
+// @section iter
+
+/// the next entry in a flat map, in key order.
+// @int i the last index, or zero to start
+// @param pkey pointer to a key variable
+// @param pvalue pointer to a value variable
+// @return the index of the entry, or zero if there are no more
+int fmap_next(FMap *m, int i, void *pkey, void *pvalue) {
+    int n = m->size, k;
+    if (n == 0)
+        return 0;
+    if (i == 0 || 2*i + 1 <= n) { // leftmost of the right subtree
+        k = i == 0 ? 1 : 2*i + 1;
+        while (2*k <= n)
+            k *= 2;
+    } else { // up to the first ancestor whose left subtree we were in
+        k = lower_bound_index(i);
+        if (k == 0)
+            return 0;
+    }
+    *(void**)pkey = m->keys[k];
+    *(void**)pvalue = m->values[k];
+    return k;
+}
+
+/// iterate over a flat map in key order.
+// @param k variable for key
+// @param v variable for value
+// @param m the flat map
+// @macro FOR_FMAP
+
+// flat maps are Iterable; `next` gives keys, `nextpair` keys and values
+typedef struct FMapIterator_ {
+    bool (*next)(Iterator *iter, void *pval);
+    bool (*nextpair)(Iterator *iter, void *pkey, void *pval);
+    int len;
+    FMap *m;
+    int idx;
+} FMapIterator;
+
+static bool iterator_fmap_nextpair(Iterator *iter, void *pkey, void *pval) {
+    FMapIterator *fi = (FMapIterator*)iter;
+    fi->idx = fmap_next(fi->m,fi->idx,pkey,pval);
+    return fi->idx > 0;
+}
+
+static bool iterator_fmap_next(Iterator *iter, void *pval) {
+    void *pnone;
+    return iterator_fmap_nextpair(iter,pval,(void*)&pnone);
+}
+
+static Iterator* iterator_fmap_init(const void *o) {
+    FMapIterator *iter = obj_new(FMapIterator,NULL);
+    iter->m = (FMap*)o;
+    iter->idx = 0;
+    iter->next = iterator_fmap_next;
+    iter->nextpair = iterator_fmap_nextpair;
+    iter->len = fmap_size((FMap*)o);
+    return (Iterator*)iter;
+}
+
+static Iterable i_fmap = {
+    iterator_fmap_init
+};
+
+static Accessor i_fmap_lookup = {
+    (ObjLookup)fmap_get
+};
+
+static void init_fmap_interfaces() {
+    interface_add(interface_typeof(Iterable),t_fmap,&i_fmap);
+    interface_add(interface_typeof(Accessor),t_fmap,&i_fmap_lookup);
+}
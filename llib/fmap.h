@@ -0,0 +1,41 @@
+/*
+* llib little C library
+* BSD licence
+* Copyright Steve Donovan, 2013
+*/
+
+#ifndef _LLIB_FMAP_H
+#define _LLIB_FMAP_H
+
+#include "map.h"
+
+typedef struct FMap_ {
+    int size;
+    int ktype, vtype;  // LIST_PTR, LIST_REF or LIST_STRING
+    void **keys;       // in search order, from 1 to size
+    void **values;
+    unsigned long long *prefix; // string keys only
+    char *strings;     // copies of string keys and values
+} FMap;
+
+#define fmap_size(m) ((m)->size)
+
+#define fmap_geti(m,k) ((intptr_t)fmap_get(m,(void*)(k)))
+#define fmap_gets(m,key) fmap_get(m,(void*)key)
+
+FMap *fmap_new(MapKeyValue *mkv, int n, int ktype, int vtype);
+FMap *fmap_new_str_ptr(MapKeyValue *mkv, int n);
+FMap *fmap_new_str_str(MapKeyValue *mkv, int n);
+FMap *fmap_new_ptr_ptr(MapKeyValue *mkv, int n);
+FMap *fmap_from_map(Map *m);
+
+bool fmap_object(void *obj);
+
+void *fmap_get(FMap *m, void *key);
+bool fmap_contains(FMap *m, void *key);
+int fmap_next(FMap *m, int i, void *pkey, void *pvalue);
+
+#define FOR_FMAP(k,v,m) for (int i_##k = fmap_next(m,0,&k,&v); i_##k > 0; \
+i_##k = fmap_next(m,i_##k,&k,&v))
+
+#endif
@@ -0,0 +1,390 @@
+/*
+* llib little C library
+* BSD licence
+* Copyright Steve Donovan, 2013
+*/
+
+/***
+### Hash Maps.
+
+When keys only need looking up, and not visiting in order, a hash map
+avoids the pointer-chasing and repeated comparisons of `Map`.
+Keys and values are kept together in one array of slots, using _Robin Hood_
+open addressing: an entry which is further from its home slot takes the place
+of one which is nearer, so that no entry is very far from home and a lookup can
+stop as soon as it passes the place where its key would have been.
+Removal shifts the following entries back, so there are no tombstones.
+
+The kinds of keys and values, and who owns them, are the same as for maps:
+`hmap_new_str_ptr` copies the string keys and leaves the values alone,
+`hmap_new_str_ref` also owns its values, and so forth.
+
+    HMap *m = hmap_new_str_ptr();
+    hmap_puti(m,"one",1);
+    hmap_puti(m,"two",2);
+    printf("%d\n",(int)hmap_geti(m,"two"));
+    char *key;
+    intptr_t val;
+    FOR_HMAP(key,val,m)
+        printf("%s %d\n",key,(int)val);
+
+The order of iteration is not defined. Hash maps implement `Iterable` and `Accessor`,
+so that they can be written out as JSON and used as template data.
+
+See `examples/words.c`.
+
+@module hmap
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "hmap.h"
+#include "interface.h"
+
+#define INITIAL_SLOTS 16
+
+static int t_hmap;
+static void init_hmap_interfaces();
+
+static unsigned int hash_str(const char *s) {
+    unsigned int h = 2166136261u;
+    for (; *s; s++)
+        h = (h ^ (unsigned char)*s) * 16777619u;
+    return h;
+}
+
+// keys may be small integers as well as pointers, so all the bits are mixed
+static unsigned int hash_key(HMap *m, const void *key) {
+    unsigned int h;
+    if (m->ktype & LIST_STR)
+        h = hash_str((const char*)key);
+    else
+        h = (unsigned int)(((unsigned long long)(uintptr_t)key * 0x9E3779B97F4A7C15ull) >> 32);
+    return h ? h : 1;  // zero marks an empty slot
+}
+
+static bool key_equals(HMap *m, const void *a, const void *b) {
+    if (m->ktype & LIST_STR)
+        return strcmp((const char*)a,(const char*)b) == 0;
+    else
+        return a == b;
+}
+
+// how far a slot is from where its hash would put it
+#define probe_dist(m,h,i) (((i) - (h)) & (m)->mask)
+
+static void dispose_slot(HMap *m, HMapSlot *s) {
+    if (m->ktype & LIST_REF)
+        obj_unref(s->key);
+    if (m->vtype & LIST_REF)
+        obj_unref(s->value);
+}
+
+/// clear all entries out of a hash map.
+// Owned keys and values are released.
+void hmap_clear(HMap *m) {
+    if (m->slots && (m->ktype & LIST_REF || m->vtype & LIST_REF)) {
+        for (unsigned int i = 0; i <= m->mask; i++) {
+            if (m->slots[i].hash)
+                dispose_slot(m,&m->slots[i]);
+        }
+    }
+    free(m->slots);
+    m->slots = NULL;
+    m->mask = 0;
+    m->size = 0;
+}
+
+/// Making New Hash Maps
+// @section new
+
+/// make a new hash map.
+// @int ktype kind of key, `LIST_PTR` or `LIST_STRING`
+// @int vtype kind of value, `LIST_PTR`, `LIST_REF` or `LIST_STRING`
+HMap *hmap_new(int ktype, int vtype) {
+    if (! t_hmap) {
+        t_hmap = obj_new_type(HMap,hmap_clear);
+        init_hmap_interfaces();
+    }
+    HMap *m = (HMap*)obj_new_from_type(t_hmap);
+    m->slots = NULL;
+    m->mask = 0;
+    m->size = 0;
+    m->ktype = ktype;
+    m->vtype = vtype;
+    return m;
+}
+
+/// make a new hash map with string keys and pointer values.
+// The keys are copied, and owned by the map.
+HMap *hmap_new_str_ptr() {
+    return hmap_new(LIST_STRING,LIST_PTR);
+}
+
+/// make a new hash map with string keys and refcounted values.
+HMap *hmap_new_str_ref() {
+    return hmap_new(LIST_STRING,LIST_REF);
+}
+
+/// make a new hash map with string keys and string values.
+HMap *hmap_new_str_str() {
+    return hmap_new(LIST_STRING,LIST_STRING);
+}
+
+/// make a new hash map with pointer keys and pointer values.
+// It's possible to use integers up to uintptr_t size as well.
+HMap *hmap_new_ptr_ptr() {
+    return hmap_new(LIST_PTR,LIST_PTR);
+}
+
+/// make a new hash map with pointer keys and refcounted values.
+HMap *hmap_new_ptr_ref() {
+    return hmap_new(LIST_PTR,LIST_REF);
+}
+
+/// make a new hash map with pointer keys and string values.
+HMap *hmap_new_ptr_str() {
+    return hmap_new(LIST_PTR,LIST_STRING);
+}
+
+/// is this object a hash map?
+bool hmap_object(void *obj) {
+    return obj_type_index(obj) == t_hmap;
+}
+
+/// Insertion, removal and retrieval
+// @section put
+
+// find the slot holding the key, or -1
+static int find_slot(HMap *m, const void *key, unsigned int h) {
+    if (! m->slots)
+        return -1;
+    for (unsigned int i = h, dist = 0; ; i++, dist++) {
+        HMapSlot *s = &m->slots[i & m->mask];
+        if (! s->hash || probe_dist(m,s->hash,i) < dist)
+            return -1;
+        if (s->hash == h && key_equals(m,s->key,key))
+            return i & m->mask;
+    }
+}
+
+// put a new entry, displacing any entry nearer its home; returns where it went
+static unsigned int insert_slot(HMap *m, HMapSlot entry) {
+    unsigned int res = (unsigned int)-1;
+    for (unsigned int i = entry.hash, dist = 0; ; i++, dist++) {
+        HMapSlot *s = &m->slots[i & m->mask];
+        if (! s->hash) {
+            *s = entry;
+            return res == (unsigned int)-1 ? (i & m->mask) : res;
+        }
+        unsigned int sdist = probe_dist(m,s->hash,i);
+        if (sdist < dist) {
+            HMapSlot tmp = *s;
+            *s = entry;
+            entry = tmp;
+            if (res == (unsigned int)-1)
+                res = i & m->mask;
+            dist = sdist;
+        }
+    }
+}
+
+static void grow(HMap *m) {
+    HMapSlot *old = m->slots;
+    unsigned int n = old ? m->mask + 1 : 0;
+    unsigned int nslots = old ? 2*n : INITIAL_SLOTS;
+    m->slots = (HMapSlot*)calloc(nslots,sizeof(HMapSlot));
+    m->mask = nslots - 1;
+    for (unsigned int i = 0; i < n; i++) {
+        if (old[i].hash)
+            insert_slot(m,old[i]);
+    }
+    free(old);
+}
+
+// up to 7/8 of the slots may be used
+static void **put_key(HMap *m, void *key, unsigned int h, bool *added) {
+    int i = find_slot(m,key,h);
+    if (i >= 0) {
+        // like maps, we take over a refcounted string key, so let it go
+        if (m->ktype & LIST_STR && key != m->slots[i].key && obj_refcount(key) != -1)
+            obj_unref(key);
+        *added = false;
+        return &m->slots[i].value;
+    }
+    if (! m->slots || 8*(m->size + 1) > 7*(m->mask + 1))
+        grow(m);
+    HMapSlot entry;
+    entry.hash = h;
+    entry.key = (m->ktype & LIST_STR) ? str_cpy((char*)key) : key;
+    entry.value = NULL;
+    ++m->size;
+    *added = true;
+    return &m->slots[insert_slot(m,entry)].value;
+}
+
+/// insert a value using a key.
+// As with maps, string keys and values are copied unless they are
+// refcounted, in which case the map takes them over. A refcounted value
+// which is replaced is released.
+// @return `true` if the key was new
+bool hmap_put(HMap *m, void *key, void *value) {
+    bool added;
+    void **pval = put_key(m,key,hash_key(m,key),&added);
+    if (m->vtype == LIST_STRING)
+        value = str_cpy((char*)value);
+    if (! added && m->vtype & LIST_REF && *pval != value)
+        obj_unref(*pval);
+    *pval = value;
+    return added;
+}
+
+/// a pointer to the value for this key, adding the key if needed.
+// A new key has a NULL value. This is the fast way to update a value,
+// for instance when counting things:
+//
+//     intptr_t *count = (intptr_t*)hmap_put_ptr(m,word);
+//     ++*count;
+//
+// The pointer is only good until the next insertion.
+void **hmap_put_ptr(HMap *m, void *key) {
+    bool added;
+    return put_key(m,key,hash_key(m,key),&added);
+}
+
+/// insert an array of key/value pairs.
+void hmap_put_keyvalues(HMap *m, MapKeyValue *mkv) {
+    for(; mkv->key; ++mkv) {
+        hmap_put(m,mkv->key,mkv->value);
+    }
+}
+
+/// get the value associated with a key.
+// @return the value, or NULL if not found, or the value was NULL.
+void *hmap_get(HMap *m, void *key) {
+    int i = find_slot(m,key,hash_key(m,key));
+    return i >= 0 ? m->slots[i].value : NULL;
+}
+
+/// get an integer value from a hash map.
+// @tparam HMap* m
+// @param key cast to void*
+// @treturn int
+// @function hmap_geti
+
+/// put an integer value into a hash map.
+// @tparam HMap* m
+// @param key cast to void*
+// @tparam value cast to void*
+// @function hmap_puti
+
+/// does the hash map contain this key?
+// @treturn bool `true` if the key is found, even if the value was NULL.
+bool hmap_contains(HMap *m, void *key) {
+    return find_slot(m,key,hash_key(m,key)) >= 0;
+}
+
+/// remove key/value, freeing any allocated memory.
+// @return true if the key was found.
+bool hmap_delete(HMap *m, void *key) {
+    int i = find_slot(m,key,hash_key(m,key));
+    if (i < 0)
+        return false;
+    unsigned int hole = i;
+    dispose_slot(m,&m->slots[hole]);
+    // entries which are away from home move back one
+    for (;;) {
+        unsigned int next = (hole + 1) & m->mask;
+        HMapSlot *s = &m->slots[next];
+        if (! s->hash || probe_dist(m,s->hash,next) == 0)
+            break;
+        m->slots[hole] = *s;
+        hole = next;
+    }
+    m->slots[hole].hash = 0;
+    --m->size;
+    return true;
+}
+
+/// Iterating over hash maps
+// @section iter
+
+/// the next entry in a hash map.
+// @int i the last index, or -1 to start
+// @param pkey pointer to a key variable
+// @param pvalue pointer to a value variable
+// @return the index of the entry, or -1 if there are no more
+int hmap_next(HMap *m, int i, void *pkey, void *pvalue) {
+    if (! m->slots)
+        return -1;
+    for (++i; i <= (int)m->mask; i++) {
+        HMapSlot *s = &m->slots[i];
+        if (s->hash) {
+            *(void**)pkey = s->key;
+            *(void**)pvalue = s->value;
+            return i;
+        }
+    }
+    return -1;
+}
+
+/// iterate over a hash map.
+// @param k variable for key
+// @param v variable for value
+// @param m the hash map
+// @macro FOR_HMAP
+
+/// Get the key/value pairs of a hash map as an array.
+MapKeyValue *hmap_to_array(HMap *m) {
+    MapKeyValue *res = array_new(MapKeyValue,m->size), *kp = res;
+    void *key, *value;
+    FOR_HMAP(key,value,m) {
+        kp->key = key;
+        kp->value = value;
+        ++kp;
+    }
+    return res;
+}
+
+// hash maps are Iterable; `next` gives keys, `nextpair` keys and values
+typedef struct HMapIterator_ {
+    bool (*next)(Iterator *iter, void *pval);
+    bool (*nextpair)(Iterator *iter, void *pkey, void *pval);
+    int len;
+    HMap *m;
+    int idx;
+} HMapIterator;
+
+static bool iterator_hmap_nextpair(Iterator *iter, void *pkey, void *pval) {
+    HMapIterator *hi = (HMapIterator*)iter;
+    hi->idx = hmap_next(hi->m,hi->idx,pkey,pval);
+    return hi->idx >= 0;
+}
+
+static bool iterator_hmap_next(Iterator *iter, void *pval) {
+    void *pnone;
+    return iterator_hmap_nextpair(iter,pval,(void*)&pnone);
+}
+
+static Iterator* iterator_hmap_init(const void *o) {
+    HMapIterator *iter = obj_new(HMapIterator,NULL);
+    iter->m = (HMap*)o;
+    iter->idx = -1;
+    iter->next = iterator_hmap_next;
+    iter->nextpair = iterator_hmap_nextpair;
+    iter->len = hmap_size((HMap*)o);
+    return (Iterator*)iter;
+}
+
+static Iterable i_hmap = {
+    iterator_hmap_init
+};
+
+static Accessor i_hmap_lookup = {
+    (ObjLookup)hmap_get
+};
+
+static void init_hmap_interfaces() {
+    interface_add(interface_typeof(Iterable),t_hmap,&i_hmap);
+    interface_add(interface_typeof(Accessor),t_hmap,&i_hmap_lookup);
+}
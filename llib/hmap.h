@@ -0,0 +1,55 @@
+/*
+* llib little C library
+* BSD licence
+* Copyright Steve Donovan, 2013
+*/
+
+#ifndef _LLIB_HMAP_H
+#define _LLIB_HMAP_H
+
+#include "list.h"
+
+typedef struct HMapSlot_ {
+    unsigned int hash; // zero for an empty slot
+    void *key;
+    void *value;
+} HMapSlot;
+
+typedef struct HMap_ {
+    HMapSlot *slots;
+    unsigned int mask;
+    int size;
+    int ktype, vtype;  // LIST_PTR, LIST_REF or LIST_STRING
+} HMap;
+
+#define hmap_size(m) ((m)->size)
+
+#define hmap_geti(m,k) ((intptr_t)hmap_get(m,(void*)(k)))
+#define hmap_puti(m,k,v) hmap_put(m,(void*)(k),(void*)(v))
+#define hmap_gets(m,key) hmap_get(m,(void*)key)
+#define hmap_puts(m,key,val) hmap_put(m,(void*)key,(void*)val)
+
+HMap *hmap_new(int ktype, int vtype);
+HMap *hmap_new_str_ptr();
+HMap *hmap_new_str_ref();
+HMap *hmap_new_str_str();
+HMap *hmap_new_ptr_ptr();
+HMap *hmap_new_ptr_ref();
+HMap *hmap_new_ptr_str();
+
+bool hmap_object(void *obj);
+
+void hmap_clear(HMap *m);
+bool hmap_put(HMap *m, void *key, void *value);
+void **hmap_put_ptr(HMap *m, void *key);
+void hmap_put_keyvalues(HMap *m, MapKeyValue *mkv);
+void *hmap_get(HMap *m, void *key);
+bool hmap_contains(HMap *m, void *key);
+bool hmap_delete(HMap *m, void *key);
+int hmap_next(HMap *m, int i, void *pkey, void *pvalue);
+MapKeyValue *hmap_to_array(HMap *m);
+
+#define FOR_HMAP(k,v,m) for (int i_##k = hmap_next(m,-1,&k,&v); i_##k >= 0; \
+i_##k = hmap_next(m,i_##k,&k,&v))
+
+#endif
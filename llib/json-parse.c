@@ -14,6 +14,16 @@
 #include "scan.h"
 #include "json.h"
 
+static bool s_intern_keys;
+
+/// intern the keys of parsed JSON maps.
+// Documents with many maps usually repeat the same few keys, which are then
+// shared, and lookups with interned names are mostly pointer comparisons.
+// Call this at startup; see `str_intern`.
+void json_intern_keys(bool on) {
+    s_intern_keys = on;
+}
+
 // important thing to remember about this parser is that it assumes that
 // the token state has already been advanced with `scan_next`.
 static PValue json_parse(ScanState *ts) {
@@ -39,6 +49,11 @@ static PValue json_parse(ScanState *ts) {
                     err = value_error("expected 'key':<value> in map");
                     break;
                 }
+                if (s_intern_keys) {
+                    char *ikey = str_intern(key);
+                    obj_unref(key);
+                    key = ikey;
+                }
                 seq_add(ss,key);
                 scan_next(ts); // after ':' is the value...
             }
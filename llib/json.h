@@ -20,6 +20,7 @@ PValue value_array_values_ (intptr_t sm,...);
 char *json_tostring(PValue v);
 PValue json_parse_string(const char *str);
 PValue json_parse_file(const char *file);
+void json_intern_keys(bool on);
 
 #ifndef LLIB_NO_VALUE_ABBREV
 #define VM value_map_of_values
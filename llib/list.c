@@ -67,12 +67,115 @@ ListIter list_new_item(List *ls, int sz) {
     return (ListIter)alloc->alloc(alloc,sz);
 }
 
+// Node slabs. Container nodes are carved out of chunks, and go onto a free list
+// when they are freed. Nodes are all big enough for a ListEntry or a MapEntry.
+#define NODE_SIZE (4*sizeof(void*))
+#define NODE_CHUNK 16384
+
+typedef struct NodeChunk_ {
+    struct NodeChunk_ *next;
+    void *pad;  // keeps nodes aligned as malloc would
+} NodeChunk;
+
+typedef struct NodeSlab_ {
+    ObjAllocator alloc;
+    void *free_list;
+    char *bump, *bump_end;  // unused tail of the newest chunk
+    NodeChunk *chunks;
+} NodeSlab;
+
+static void *slab_node_alloc(NodeSlab *ns, int size) {
+    void *p = ns->free_list;
+    if (size > (int)NODE_SIZE) {
+        fprintf(stderr,"llib: node of %d bytes is too big for a node slab\n",size);
+        abort();
+    }
+    if (p) {
+        ns->free_list = *(void**)p;
+        return p;
+    }
+    if (ns->bump + NODE_SIZE > ns->bump_end) {
+        NodeChunk *ch = (NodeChunk*)malloc(NODE_CHUNK);
+        ch->next = ns->chunks;
+        ns->chunks = ch;
+        ns->bump = (char*)(ch + 1);
+        ns->bump_end = (char*)ch + NODE_CHUNK;
+    }
+    p = ns->bump;
+    ns->bump += NODE_SIZE;
+    return p;
+}
+
+static void slab_node_free(NodeSlab *ns, void *p) {
+    *(void**)p = ns->free_list;
+    ns->free_list = p;
+}
+
+static void slab_release(NodeSlab *ns) {
+    NodeChunk *next;
+    for (NodeChunk *ch = ns->chunks; ch; ch = next) {
+        next = ch->next;
+        free(ch);
+    }
+    ns->chunks = NULL;
+    ns->free_list = NULL;
+    ns->bump = ns->bump_end = NULL;
+}
+
+// the shared allocator uses the calling thread's slab
+static LLIB_TLS NodeSlab s_thread_nodes;
+
+static void *thread_node_alloc(void *a, int size) {
+    return slab_node_alloc(&s_thread_nodes,size);
+}
+
+static void thread_node_free(void *a, void *p) {
+    slab_node_free(&s_thread_nodes,p);
+}
+
+static ObjAllocator s_node_allocator = {
+    thread_node_alloc, thread_node_free, NULL
+};
+
+// a container's own slab is its allocator
+static void *own_node_alloc(void *a, int size) {
+    return slab_node_alloc((NodeSlab*)a,size);
+}
+
+static void own_node_free(void *a, void *p) {
+    slab_node_free((NodeSlab*)a,p);
+}
+
+// shared with map.c
+bool list_owns_nodes_(List *ls) {
+    return ls->kind->alloc->free == own_node_free;
+}
+
+// free all the nodes at once; when disposing, the slab and its kind go as well
+void list_free_nodes_(List *ls, bool dispose) {
+    NodeSlab *ns = (NodeSlab*)ls->kind->alloc;
+    slab_release(ns);
+    if (dispose) {
+        free(ns);
+        free(ls->kind);
+    }
+}
+
 static void List_dispose(List *self) {
+    if (list_owns_nodes_(self)) {
+        if (self->flags & LIST_REF) {
+            FOR_LIST(item,self)
+                obj_unref(item->data);
+        }
+        list_free_nodes_(self,true);
+        return;
+    }
     list_erase(self,self->first,NULL);
 }
 
+// not the difference, which may not fit into an int
 static int simple_pointer_compare(void *p1, void *p2) {
-    return (intptr_t)p1 - (intptr_t)p2;
+    return (intptr_t)p1 < (intptr_t)p2 ? -1 : (intptr_t)p1 > (intptr_t)p2;
 }
 
 static int simple_pointer_equals(void *p1, void *p2) {
@@ -97,20 +200,44 @@ static ListKind s_str_kind = {
     &obj_default_allocator
 };
 
+// interned keys are usually the same pointer when equal
+static int interned_compare(const char *s1, const char *s2) {
+    return s1 == s2 ? 0 : strcmp(s1,s2);
+}
+
+static int interned_equals(const char *s1, const char *s2) {
+    return s1 == s2 || strcmp(s1,s2) == 0;
+}
+
+static ListKind s_istr_kind = {
+    (ListCmpFun)interned_compare,
+    (ListEqualsFun)interned_equals,
+    &obj_default_allocator
+};
+
 static ListKind s_ptr_kind = {
     (ListCmpFun)simple_pointer_compare,
     (ListEqualsFun)simple_pointer_equals,
     &obj_default_allocator
 };
 
+/// allocator for the nodes of all new container lists and maps.
+// By default, nodes come from `malloc` one at a time. Set this at startup, before any lists or maps are made, since nodes must be
+// freed by the allocator which made them.
+// @param alloc allocator, e.g. `list_node_allocator()`, or `NULL` for `malloc` again
 void list_global_allocator(ObjAllocator *alloc) {
+    if (! alloc)
+        alloc = &obj_default_allocator;
     s_ptr_kind.alloc = alloc;
     s_str_kind.alloc = alloc;
+    s_istr_kind.alloc = alloc;
 }
 
 void list_init_(List *self, int flags) {
     self->flags = flags;
-    if (flags & LIST_STR) {
+    if (flags & LIST_INTERN) {
+        self->kind = &s_istr_kind;
+    } else if (flags & LIST_STR) {
         self->kind = &s_str_kind;
     } else {
         self->kind = &s_ptr_kind;
@@ -152,6 +279,37 @@ static Iterable list_i = {
     list_iterable
 };
 
+/// an allocator which carves nodes out of large chunks.
+// Each thread has its own free list of nodes, so this can be used by any thread.
+// The chunks are kept for reuse, not given back. To use it for all lists and maps:
+//
+//     list_global_allocator(list_node_allocator());
+//
+ObjAllocator *list_node_allocator() {
+    return &s_node_allocator;
+}
+
+static void copy_kind(List *s);
+
+/// give a container list or map its own slab of nodes.
+// Nodes are carved from chunks which belong to the container, and are
+// released together when it is disposed, without visiting each node unless the
+// values need releasing. The container must still be empty. `map_use_node_slab`
+// does this for maps. A container is only used by one thread at a time, so
+// this needs no locking.
+// @return false if the list is not empty, or is a list of nodes
+bool list_use_node_slab(List *ls) {
+    if (list_is_node(ls) || ls->first)
+        return false;
+    NodeSlab *ns = (NodeSlab*)calloc(1,sizeof(NodeSlab));
+    ns->alloc.alloc = own_node_alloc;
+    ns->alloc.free = own_node_free;
+    ns->alloc.data = ns;
+    copy_kind(ls);
+    ls->kind->alloc = &ns->alloc;
+    return true;
+}
+
 List *list_new (int flags) {
     if (! t_list) {
         t_list = obj_new_type(List,List_dispose);
@@ -179,6 +337,8 @@ List *list_new_node(bool str) {
 List *list_new_like(List *other) {
     List *ls = list_new(other->flags);
     ls->kind = other->kind;
+    if (list_owns_nodes_(other)) // a slab has only one owner
+        list_use_node_slab(ls);
     return ls;
 }
 
@@ -187,7 +347,12 @@ ListIter private_new_item(List *ls, void *data, int size) {
         return (ListIter)data;
     }
     ListIter node = list_new_item(ls,size);
-    if (ls->flags & LIST_STRING) {
+    if (ls->flags & LIST_INTERN) {
+        char *s = str_intern((char*)data);
+        if (obj_refcount(data) != -1)  // we were given this reference
+            obj_unref(data);
+        data = s;
+    } else if (ls->flags & LIST_STRING) {
         data = str_cpy ((char*)data);
     }
     node->data = data;
@@ -41,7 +41,9 @@ enum {
     LIST_NODE = 1,
     LIST_REF = 2,
     LIST_STR = 4,
-    LIST_STRING = LIST_STR + LIST_REF
+    LIST_STRING = LIST_STR + LIST_REF,
+    LIST_INTERN = 8,
+    LIST_ISTRING = LIST_STRING + LIST_INTERN
 };
 
 #define FOR_LIST_ITEM(type,var,list) for (type *var = (type*)(list)->first; var != NULL; var = (type*)var->_next)
@@ -63,6 +65,8 @@ for (ListIter var = (ListIter)listw_first(lw);\
 
 List *list_new (int flags);
 void list_global_allocator(ObjAllocator *alloc);
+ObjAllocator *list_node_allocator();
+bool list_use_node_slab(List *ls);
 ListIter private_new_item(List *ls, void *data, int size);
 bool list_object (void *obj);
 List *list_new_ptr();
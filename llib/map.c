@@ -13,6 +13,13 @@ comparison functions (which are like `strcmp`) and key allocation. The nodes hav
 structure, so structs with `LIST_HEADER` can be also put into maps, provided the next
 field is the key.
 
+The trees are kept balanced as _scapegoat trees_, which need nothing extra in the
+nodes. An insertion which goes deeper than `log(n)` to base 3/2 rebuilds the
+smallest unbalanced subtree above the new node, and the whole tree is rebuilt when
+removals have taken it below two-thirds of its largest size. So lookups are
+always `O(log n)`, even if the keys come in sorted order, and insertions and removals
+are `O(log n)` on average.
+
 Keys are always pointers, but like with string lists,  char* pointers are a special case.
 
 If the keys aren't strings, then the comparison function is simply the less-than operator.
@@ -34,13 +41,18 @@ sorts the result, giving the ten most common words.
 
 // first becomes the tree root
 #define root(m) ((m)->first)
-// the pointer value type is put into the pointer value last
-#define vtype(m) ((intptr_t)(m)->last)
-#define set_vtype(m,t) ((m)->last=(ListIter)t)
+// the pointer value type is put into the low bits of the pointer value last;
+// the rest holds the largest size since the whole tree was last rebuilt
+#define vtype(m) ((intptr_t)(m)->last & 3)
+#define set_vtype(m,t) ((m)->last=(ListIter)(intptr_t)(t))
+#define max_size(m) ((intptr_t)(m)->last >> 2)
+#define set_max_size(m,n) ((m)->last=(ListIter)(((intptr_t)(n) << 2) | vtype(m)))
 
 #define key_data item_data
 
 /// for-statement for iterating over a map.
+// The iterator lives on the stack, so nothing is allocated and it is
+// safe to break out of the loop.
 // @tparam MapIter var the loop variable
 // @tparam m the map
 // @macro FOR_MAP
@@ -55,6 +67,8 @@ enum MapType {
     MAP_KEY_POINTER = LIST_PTR, MAP_KEY_STRING = LIST_STRING
 };
 
+#define owns_keys(flags) (((flags) & MAP_KEY_STRING) == MAP_KEY_STRING)
+
 enum MapValue {
     MAP_NODE = 0, MAP_STRING = 1, MAP_POINTER = 2, MAP_REF = 3,
 };
@@ -64,7 +78,7 @@ static void dispose_map_entries(Map *m, PEntry node) {
     //printf("%d %d %p %d\n",vt,kt,node,node->data);
 
     // we are a container with string keys
-    if (kt == MAP_KEY_STRING && vt != MAP_NODE) {
+    if (owns_keys(kt) && vt != MAP_NODE) {
         obj_unref(node->key);
     }
     if (vt == MAP_NODE) { // struct map
@@ -72,26 +86,145 @@ static void dispose_map_entries(Map *m, PEntry node) {
     } else {
         if (vt & MAP_STRING) // container disposes of references
             obj_unref(node->data);
-        free(node);
+        ObjAllocator *alloc = m->kind->alloc;
+        alloc->free(alloc,node);
     }
 }
 
 // Current implementation of Map struct is exactly the same as the List struct,
 // although they are distinct types with distinct dispose functions.
+// A map object is followed by the subtree sizes used by `map_rank` and `map_select`;
+// these are kept in a table beside the tree, since `MapEntry` has no room for them,
+// and only once they are first asked for.
+
+typedef struct SizeSlot_ {
+    PEntry node;
+    int size;
+} SizeSlot;
+
+typedef struct MapSizes_ {
+    SizeSlot *slots;
+    unsigned int mask;
+    int count;
+} MapSizes;
+
+typedef struct MapObject_ {
+    Map map;
+    MapSizes *sizes;
+} MapObject;
+
+#define sizes_of(m) (((MapObject*)(m))->sizes)
+
+#define hash_node(p) ((unsigned int)((uintptr_t)(p) >> 4) * 2654435761u)
+
+// the slot of a node, or the empty slot where it would go (linear probing)
+static SizeSlot *size_slot(MapSizes *S, PEntry node) {
+    unsigned int i = hash_node(node) & S->mask;
+    while (S->slots[i].node && S->slots[i].node != node)
+        i = (i + 1) & S->mask;
+    return &S->slots[i];
+}
+
+static int node_size(MapSizes *S, PEntry node) {
+    return node ? size_slot(S,node)->size : 0;
+}
+
+static void set_size(MapSizes *S, PEntry node, int size) {
+    if (2*(S->count + 1) > (int)S->mask + 1) { // keep the table at most half full
+        SizeSlot *old = S->slots;
+        unsigned int n = S->mask + 1;
+        S->mask = 2*n - 1;
+        S->slots = (SizeSlot*)calloc(2*n,sizeof(SizeSlot));
+        for (unsigned int i = 0; i < n; i++) {
+            if (old[i].node)
+                *size_slot(S,old[i].node) = old[i];
+        }
+        free(old);
+    }
+    SizeSlot *slot = size_slot(S,node);
+    if (! slot->node) {
+        slot->node = node;
+        ++S->count;
+    }
+    slot->size = size;
+}
+
+#define add_size(S,node,n) (size_slot(S,node)->size += (n))
+
+// later slots in the run move back into the hole, so lookups need no tombstones
+static void remove_size(MapSizes *S, PEntry node) {
+    unsigned int i = (unsigned int)(size_slot(S,node) - S->slots), j = i;
+    if (! S->slots[i].node)
+        return;
+    S->slots[i].node = NULL;
+    --S->count;
+    for (;;) {
+        j = (j + 1) & S->mask;
+        if (! S->slots[j].node)
+            return;
+        unsigned int h = hash_node(S->slots[j].node) & S->mask;
+        // can the entry at j live at i? Only if its home is not between them
+        if (i < j ? (h <= i || h > j) : (h <= i && h > j)) {
+            S->slots[i] = S->slots[j];
+            S->slots[j].node = NULL;
+            i = j;
+        }
+    }
+}
+
+static int fill_sizes(MapSizes *S, PEntry node) {
+    if (! node)
+        return 0;
+    int size = fill_sizes(S,node->_left) + 1 + fill_sizes(S,node->_right);
+    set_size(S,node,size);
+    return size;
+}
+
+// the subtree sizes of a map, made the first time they are needed
+static MapSizes *map_sizes(Map *m) {
+    MapSizes *S = sizes_of(m);
+    if (! S) {
+        S = (MapSizes*)malloc(sizeof(MapSizes));
+        S->mask = 15;
+        S->count = 0;
+        S->slots = (SizeSlot*)calloc(16,sizeof(SizeSlot));
+        fill_sizes(S,(PEntry)root(m));
+        sizes_of(m) = S;
+    }
+    return S;
+}
+
+static void drop_sizes(Map *m) {
+    MapSizes *S = sizes_of(m);
+    if (S) {
+        free(S->slots);
+        free(S);
+        sizes_of(m) = NULL;
+    }
+}
 
 void list_init_(List *self, int flags);
+bool list_owns_nodes_(List *ls);
+void list_free_nodes_(List *ls, bool dispose);
 void map_clear(Map *m);
 
+static void Map_dispose(Map *m) {
+    map_clear(m);
+    if (list_owns_nodes_(m))
+        list_free_nodes_(m,true);
+}
+
 static int t_map;
 static void init_interfaces();
 
 Map *map_new(int ktype, enum MapValue vtype) {
     if (! t_map) { // initialize
-        t_map = obj_new_type(Map,map_clear);    
+        t_map = obj_new_type_(sizeof(MapObject),"Map",(DisposeFn)Map_dispose);
         init_interfaces();
     }
     Map *m = (Map*)obj_new_from_type(t_map);
     list_init_((List*)m,ktype);
+    sizes_of(m) = NULL;
     set_vtype(m,vtype);
     return m;
 }
@@ -123,6 +256,24 @@ Map *map_new_str_str() {
     return map_new(LIST_STRING, MAP_STRING);
 }
 
+/// make a new map with interned string keys and pointer values.
+// Keys are interned with `str_intern`, so that looking up an interned
+// string usually needs only a pointer comparison at each node.
+// Other strings can still be used as keys, at the usual cost.
+Map *map_new_istr_ptr() {
+    return map_new(LIST_ISTRING, MAP_POINTER);
+}
+
+/// make a new map with interned string keys and refcounted values.
+Map *map_new_istr_ref() {
+    return map_new(LIST_ISTRING, MAP_REF);
+}
+
+/// make a new map with interned string keys and string values.
+Map *map_new_istr_str() {
+    return map_new(LIST_ISTRING, MAP_STRING);
+}
+
 /// make a new map with pointer keys and pointer values.
 // It's possible to use integers up to uintptr_t size as well.
 Map *map_new_ptr_ptr() {
@@ -144,10 +295,58 @@ Map *map_new_ptr_str() {
 
 /// clear all entries out of a Map.
 void map_clear(Map *m) {
-    if (root(m) != NULL) {
-        map_visit(m,map_first(m),(MapCallback)dispose_map_entries,1);
+    PEntry node = map_first(m), last = NULL;
+    drop_sizes(m);
+    if (node == NULL)
+        return;
+    if (list_owns_nodes_(m)) { // only the keys and values need visiting, if owned
+        if (owns_keys(m->flags) || vtype(m) & MAP_STRING) {
+            FOR_MAP(iter,m) {
+                if (owns_keys(m->flags))
+                    obj_unref(iter->key);
+                if (vtype(m) & MAP_STRING)
+                    obj_unref(iter->value);
+            }
+        }
+        list_free_nodes_(m,false);
         root(m) = NULL;
+        m->size = 0;
+        set_max_size(m,0);
+        return;
+    }
+    // Entries are disposed in post-order, as `map_visit` would do, but with an
+    // explicit stack, so that a badly unbalanced tree cannot overflow the C stack.
+    PEntry local[64], *stack = local;
+    int n = 0, cap = 64;
+    while (node != NULL || n > 0) {
+        if (node != NULL) {
+            if (n == cap) {
+                cap *= 2;
+                if (stack == local) {
+                    stack = (PEntry*)malloc(cap*sizeof(PEntry));
+                    memcpy(stack,local,sizeof(local));
+                } else {
+                    stack = (PEntry*)realloc(stack,cap*sizeof(PEntry));
+                }
+            }
+            stack[n++] = node;
+            node = node->_left;
+        } else {
+            PEntry top = stack[n-1];
+            if (top->_right != NULL && top->_right != last) {
+                node = top->_right;
+            } else {
+                --n;
+                dispose_map_entries(m,top);
+                last = top;
+            }
+        }
     }
+    if (stack != local)
+        free(stack);
+    root(m) = NULL;
+    m->size = 0;
+    set_max_size(m,0);
 }
 
 /// is this object a Map?
@@ -155,6 +354,12 @@ bool map_object (void *obj) {
     return obj_type_index(obj) == t_map;
 }
 
+/// does this map own its values?
+// True for maps with refcounted or string values, which are released with the map.
+bool map_owns_values(Map *m) {
+    return vtype(m) & MAP_STRING;
+}
+
 /// get the data associated with this tree node.
 // if it's a container, then we return the node's data,
 // otherwise the node itself is the data
@@ -173,12 +378,84 @@ void map_free_item(Map *m, PEntry me) {
     list_free_item((List*)m,(ListIter)me); // handles disposing the key, if necessary
 }
 
+// A tree of n nodes may be log(n) to base 3/2 deep, so with 2^31 nodes at most 53 deep.
+// This is floor(1.5^depth)
+static const long long deep_size[MAP_MAX_DEPTH] = {
+    1LL, 1LL, 2LL, 3LL, 5LL, 7LL, 11LL, 17LL, 25LL, 38LL, 57LL, 86LL, 129LL, 194LL,
+    291LL, 437LL, 656LL, 985LL, 1477LL, 2216LL, 3325LL, 4987LL, 7481LL, 11222LL,
+    16834LL, 25251LL, 37876LL, 56815LL, 85222LL, 127834LL, 191751LL, 287626LL,
+    431439LL, 647159LL, 970739LL, 1456109LL, 2184164LL, 3276246LL, 4914369LL,
+    7371554LL, 11057332LL, 16585998LL, 24878997LL, 37318496LL, 55977744LL,
+    83966617LL, 125949925LL, 188924888LL, 283387333LL, 425081000LL, 637621500LL,
+    956432250LL, 1434648375LL, 2151972563LL, 3227958844LL, 4841938267LL,
+    7262907400LL, 10894361101LL, 16341541651LL, 24512312477LL, 36768468716LL,
+    55152703075LL, 82729054613LL, 124093581919LL
+};
+
+#define too_deep(depth,size) (deep_size[depth] > (size))
+
+static int subtree_size(PEntry node) {
+    if (! node)
+        return 0;
+    return subtree_size(node->_left) + 1 + subtree_size(node->_right);
+}
+
+static PEntry *flatten(PEntry node, PEntry *out) {
+    if (! node)
+        return out;
+    out = flatten(node->_left,out);
+    *out++ = node;
+    return flatten(node->_right,out);
+}
+
+// (and record the new subtree sizes, if the map keeps them)
+static PEntry build_balanced(MapSizes *S, PEntry *nodes, int n) {
+    if (n == 0)
+        return NULL;
+    int mid = n/2;
+    PEntry node = nodes[mid];
+    node->_left = build_balanced(S,nodes,mid);
+    node->_right = build_balanced(S,nodes+mid+1,n-mid-1);
+    if (S)
+        set_size(S,node,n);
+    return node;
+}
+
+// rebuild the subtree of n nodes hanging from this edge as a perfectly balanced tree
+static void rebuild(Map *m, PEntry *edge, int n) {
+    PEntry local[64];
+    PEntry *nodes = n <= 64 ? local : (PEntry*)malloc(n*sizeof(PEntry));
+    flatten(*edge,nodes);
+    *edge = build_balanced(sizes_of(m),nodes,n);
+    if (nodes != local)
+        free(nodes);
+}
+
+// The new node is too deep, so there must be an ancestor where one side holds
+// more than two-thirds of the nodes. Going up from the new node, rebuild the first such.
+static void rebalance(Map *m, PEntry **path, int depth, PEntry item) {
+    MapSizes *S = sizes_of(m);
+    PEntry child = item;
+    int child_size = 1;
+    for (int i = depth-1; i >= 0; i--) {
+        PEntry parent = *path[i];
+        int size = S ? node_size(S,parent) : child_size + 1 +
+            subtree_size(parent->_left == child ? parent->_right : parent->_left);
+        if (3*child_size > 2*size) {
+            rebuild(m,path[i],size);
+            return;
+        }
+        child = parent;
+        child_size = size;
+    }
+}
+
 // this does the work of inserting an item into the tree.
 // There are two cases:
 //  (1) the map data is a pointer to a struct with a map/list header; it is its own key.
 //  (2) the map key and data are both pointers. But they may be different kinds
 //      of pointers, e.g. strings for keys, plain pointers/ints for values
-static PEntry put_item(Map *m, void *key, void *data, int pointer_type) {
+static PEntry new_item(Map *m, void *key, void *data, int pointer_type) {
     PEntry item = (PEntry)private_new_item(m,pointer_type ? (PEntry)key : data,sizeof(MapEntry));
     // for a pointer/string keyed map, this returns a MapEntryDefault struct,
     // and the data must also be a pointer or a string, which is put into the 'mdata' field
@@ -188,51 +465,65 @@ static PEntry put_item(Map *m, void *key, void *data, int pointer_type) {
         }
         item->data = data;
         //printf("key %d data %d\n",key,data);
-    } else { // otherwise the data contains its own key
-        key = item->key;
     }
     item->_left = NULL;
     item->_right = NULL;
-    ++m->size;
-    if (! root(m)) { // first item!
-        root(m) = (ListIter) item;
-    } else {
-        PEntry P = (PEntry)root(m);
-        PEntry last = P;
-        int order, last_order = 0;
-        ListCmpFun compare = m->kind->compare;
-        while (P) {
-            order = compare(P->key,key);
-            if (order == 0) { // gotcha - overwrite existing entry in map
-                if (pointer_type) {
-                    P->data = item->data;
-                    map_free_item(m,item);
-                } else { // put new node inplace
-                    item->_left = P->_left;
-                    item->_right = P->_right;
-                    if (last_order > 0) { // we are a left child
-                        last->_left = item;
-                    } else {
-                        last->_right = item;
-                    }
-                    obj_unref(P);
+    return item;
+}
+
+// an entry takes the value of a new item with the same key; a value which the
+// map owned is released
+static void replace_value(Map *m, PEntry P, PEntry item) {
+    if (vtype(m) & MAP_STRING && P->data != item->data)
+        obj_unref(P->data);
+    P->data = item->data;
+    map_free_item(m,item);
+}
+
+static PEntry put_item(Map *m, void *key, void *data, int pointer_type) {
+    PEntry item = new_item(m,key,data,pointer_type);
+    if (! pointer_type) // the data contains its own key
+        key = item->key;
+    // go down the tree, remembering the edges we followed
+    PEntry *path[MAP_MAX_DEPTH];
+    PEntry *edge = (PEntry*)&root(m);
+    int depth = 0;
+    ListCmpFun compare = m->kind->compare;
+    while (*edge) {
+        PEntry P = *edge;
+        int order = compare(P->key,key);
+        if (order == 0) { // gotcha - overwrite existing entry in map
+            if (pointer_type) {
+                replace_value(m,P,item);
+            } else { // put new node inplace
+                item->_left = P->_left;
+                item->_right = P->_right;
+                *edge = item;
+                if (sizes_of(m)) {
+                    set_size(sizes_of(m),item,node_size(sizes_of(m),P));
+                    remove_size(sizes_of(m),P);
                 }
-                --m->size;
-                return P;
-            } else
-            if (order > 0) { // we go down the left side
-                P = P->_left;
-                if (! P)  // and insert if we hit the edge
-                    last->_left = item;
-            } else { // down the right side, ditto
-                P = P->_right;
-                if (! P)
-                    last->_right = item;
+                obj_unref(P);
+                P = item;
             }
-            last = P;
-            last_order = order;
+            return P;
         }
+        path[depth++] = edge;
+        // we go down the left side if the key is less
+        edge = order > 0 ? &P->_left : &P->_right;
+    }
+    *edge = item;
+    ++m->size;
+    MapSizes *S = sizes_of(m);
+    if (S) { // the new node is in the subtree of every node above it
+        FOR(i,depth)
+            add_size(S,*path[i],1);
+        set_size(S,item,1);
     }
+    if (m->size > max_size(m))
+        set_max_size(m,m->size);
+    if (too_deep(depth,m->size))
+        rebalance(m,path,depth,item);
     return item;
 }
 
@@ -263,6 +554,93 @@ void map_put_keyvalues(Map *m, MapKeyValue *mkv) {
     }
 }
 
+// Merge the tree with n new items in ascending order, and rebuild it balanced.
+// As with `map_put`, a new item with an existing key gives its value to the old entry.
+static void merge_items(Map *m, PEntry *items, int n) {
+    int size = map_size(m);
+    PEntry *merged = (PEntry*)malloc((size + n)*sizeof(PEntry));
+    PEntry *nodes = merged + n; // the old nodes move down as the merge goes
+    flatten((PEntry)root(m),nodes);
+    ListCmpFun compare = m->kind->compare;
+    int i = 0, j = 0, k = 0;
+    while (i < size || j < n) {
+        int order = i == size ? 1 : (j == n ? -1 : compare(nodes[i]->key,items[j]->key));
+        if (order < 0) {
+            merged[k++] = nodes[i++];
+        } else if (order > 0) {
+            merged[k++] = items[j++];
+        } else {
+            PEntry P = nodes[i++];
+            replace_value(m,P,items[j++]);
+            merged[k++] = P;
+        }
+    }
+    root(m) = (ListIter)build_balanced(sizes_of(m),merged,k);
+    m->size = k;
+    set_max_size(m,k);
+    free(merged);
+}
+
+static bool ascending(Map *m, MapKeyValue *mkv, int n) {
+    ListCmpFun compare = m->kind->compare;
+    for (int i = 1; i < n; i++) {
+        if (compare(mkv[i-1].key,mkv[i].key) >= 0)
+            return false;
+    }
+    return true;
+}
+
+/// insert an array of key/value pairs which are sorted by key.
+// The tree is built in one pass, taking time proportional to the new pairs plus
+// the existing entries, and it is perfectly balanced afterwards. If the pairs
+// turn out not to be in strictly ascending order, they are put one at a time.
+// @param m the map
+// @param mkv the pairs
+// @int n the number of pairs, or -1 if they end with a NULL key
+// @return false if this is a struct map
+bool map_put_sorted(Map *m, MapKeyValue *mkv, int n) {
+    if (! vtype(m)) return false;
+    if (n < 0)
+        for (n = 0; mkv[n].key; n++) ;
+    if (! ascending(m,mkv,n)) {
+        FOR(i,n)
+            map_put(m,mkv[i].key,mkv[i].value);
+        return true;
+    }
+    PEntry *items = (PEntry*)malloc((n + 1)*sizeof(PEntry));
+    FOR(i,n)
+        items[i] = new_item(m,mkv[i].key,mkv[i].value,vtype(m));
+    merge_items(m,items,n);
+    free(items);
+    return true;
+}
+
+/// put all the entries of another map into this one.
+// Both maps must be pointer maps of the same kind. Like `map_put`, the other map's value
+// wins when both have a key; owned keys and values are shared, not copied. This takes time
+// proportional to the size of both maps.
+// @param m the map
+// @param other the other map
+// @return false if the maps are not of the same kind, or are struct maps
+bool map_merge(Map *m, Map *other) {
+    int vt = vtype(m), n = map_size(other), k = 0;
+    if (! vt || vt != vtype(other) || m->flags != other->flags)
+        return false;
+    PEntry *items = (PEntry*)malloc((n + 1)*sizeof(PEntry));
+    FOR_MAP(iter,other) {
+        void *key = iter->key, *data = iter->value;
+        // the map takes over these references
+        if (m->flags & LIST_STR)
+            obj_incr_(key);
+        if (vt & MAP_STRING)
+            obj_incr_(data);
+        items[k++] = new_item(m,key,data,vt);
+    }
+    merge_items(m,items,n);
+    free(items);
+    return true;
+}
+
 static PEntry map_find(Map *m, void *key, PEntry** parent_edge) {
     PEntry node = (PEntry)root(m);
     if (! node) return NULL;  // we're empty!
@@ -322,32 +700,42 @@ bool map_contains(Map *m, void *key) {
     return node != NULL;
 }
 
-static PEntry left_most_edge (PEntry node) {
-    PEntry P = node, last;
-    while (P) {
-        last = P;
-        P = P->_left;
-    }
-    return last;
-}
-
 /// remove the key and value from the map.
 PEntry map_remove(Map *m, void *key) {
     PEntry *parent_edge;
     PEntry node = map_find(m,key,&parent_edge);
     if (! node) return NULL; // not one of ours...
-    -- m->size;
-    if (m->size == 0) {// last chap in map
-         root(m) = NULL;
-         return node;
+    MapSizes *S = sizes_of(m);
+    if (S) { // the node leaves the subtree of every node above it
+        ListCmpFun compare = m->kind->compare;
+        for (PEntry P = (PEntry)root(m); P != node; P = compare(P->key,node->key) > 0 ? P->_left : P->_right)
+            add_size(S,P,-1);
     }
-
-    if (! node->_right) {
+    if (! node->_left) {
+        *parent_edge = node->_right;
+    } else if (! node->_right) {
         *parent_edge = node->_left;
-    } else {
-        PEntry nright = node->_right;
-        *parent_edge = nright;
-        left_most_edge(nright)->_left = node->_left;
+    } else { // the next node in order takes this node's place
+        PEntry *edge = &node->_right;
+        while ((*edge)->_left) {
+            if (S)
+                add_size(S,*edge,-1);
+            edge = &(*edge)->_left;
+        }
+        PEntry next = *edge;
+        *edge = next->_right;
+        next->_left = node->_left;
+        next->_right = node->_right;
+        *parent_edge = next;
+        if (S)
+            add_size(S,next,node_size(S,node) - node_size(S,next) - 1);
+    }
+    if (S)
+        remove_size(S,node);
+    -- m->size;
+    if (3*m->size < 2*max_size(m)) {
+        rebuild(m,(PEntry*)&root(m),m->size);
+        set_max_size(m,m->size);
     }
     return node;
 }
@@ -357,6 +745,8 @@ PEntry map_remove(Map *m, void *key) {
 bool map_delete(Map *m, void *key) {
     PEntry node = map_remove(m,key);
     if (! node) return false;
+    if (vtype(m) & MAP_STRING) // owned values go too
+        obj_unref(node->data);
     map_free_item(m,node);
     return true;
 }
@@ -386,57 +776,37 @@ void map_visit(void *data, PEntry node, MapCallback fun, int order) {
         fun(data,node);
 }
 
-struct ArrayMapIter {
-    MapKeyValue *kp;
-    Map *m;
-};
-
-static void add_keypair(struct ArrayMapIter *ami, PEntry node) {
-    MapKeyValue *kp = ami->kp;
-    kp->key = node->key;
-    kp->value = map_value_data(ami->m,node);
-    ami->kp = kp + 1;
-}
-
 /// Get the key/value pairs of a map as an array.
 MapKeyValue *map_to_array(Map *m)
 {
-    MapKeyValue *res = array_new(MapKeyValue,map_size(m));
-    struct ArrayMapIter *ami = obj_new(struct ArrayMapIter,NULL);
-    ami->kp = res;
-    ami->m = m;
-    map_visit(ami,(PEntry)root(m),(MapCallback)add_keypair,0);
-    obj_unref(ami);
+    MapKeyValue *res = array_new(MapKeyValue,map_size(m)), *kp = res;
+    FOR_MAP(iter,m) {
+        kp->key = iter->key;
+        kp->value = iter->value;
+        ++kp;
+    }
     return res;
 }
 
-// we keep a stack of nodes and whether they have been visited.
-// We'll reuse the default map entry for this purpose!
+// the iterator keeps a stack of the nodes whose left subtrees are being visited;
+// the current node is on top
 
-static void push_stack(MapIter iter, PEntry node, bool visited) {
-    PEntry med = obj_new(MapEntry,NULL);
-    med->key = (void*)visited;
-    med->data = node;
-    list_add(iter->vstack,med);
-}
-
-#define right_visited(item)  ((item)->key != NULL)
-
-static PEntry pop_stack(MapIter iter) {
-    return (PEntry) list_pop(iter->vstack);
-}
-
-static void go_down_left (MapIter iter) {
-    PEntry node = iter->node;
-    while (node->_left) {
-        push_stack(iter,node,false);
+static void go_down_left (MapIter iter, PEntry node) {
+    while (node) {
+        iter->stack[iter->depth++] = node;
         node = node->_left;
     }
-    iter->node = node;
 }
 
-static void map_iter_free(MapIter iter) {
-    obj_unref(iter->vstack);
+static void set_current(MapIter iter) {
+    PEntry node = iter->stack[iter->depth-1];
+    iter->node = node;
+    iter->key = node->key;
+    iter->value = map_value_data(iter->map,node);
+    if (iter->pkey) {
+        *iter->pkey = iter->key;
+        *iter->pvalue = iter->value;
+    }
 }
 
 /// convenient struct for initializing maps.
@@ -449,60 +819,169 @@ static void map_iter_free(MapIter iter) {
 // @tfield void* value
 // @table MapIter
 
-/// create a new map iterator positioned on the mininum node.
-MapIter map_iter_new (Map *m, void *pkey, void *pvalue) {
-    if (root(m) == NULL) // empty map
-        return NULL;
-    MapIter iter = obj_new(MapIterStruct,map_iter_free);
+// has a range iterator reached its upper bound?
+static bool past_end(MapIter iter) {
+    return iter->bounded && iter->map->kind->compare(iter->stack[iter->depth-1]->key,iter->hi) >= 0;
+}
+
+/// initialize an iterator over the keys from `lo` up to, but not including, `hi`.
+// This does no allocation, since `iter` may be on the stack. A NULL `lo` starts
+// at the first key, and a NULL `hi` goes on to the last.
+// @param iter iterator struct
+// @param m the map
+// @param lo lowest key
+// @param hi key to stop before
+// @param pkey optional pointer to key variable
+// @param pvalue optional pointer to value variable
+// @return `iter`, or NULL if there are no such keys
+MapIter map_iter_range (MapIterStruct *iter, Map *m, void *lo, void *hi, void *pkey, void *pvalue) {
     iter->map = m;
-    iter->node = (PEntry)root(m);
-    iter->vstack = list_new_node(false);
     iter->pkey = (void**)pkey;
     iter->pvalue = (void**)pvalue;
-    go_down_left(iter);
-    iter->key = iter->node->key;
-    iter->value = map_value_data(m,iter->node);
-    if (iter->pkey) {
-        *iter->pkey = iter->key;
-        *iter->pvalue = iter->value;
+    iter->owned = false;
+    iter->bounded = hi != NULL;
+    iter->hi = hi;
+    iter->depth = 0;
+    // the path to the first key not less than lo, keeping only the nodes we went left from
+    ListCmpFun compare = m->kind->compare;
+    PEntry node = (PEntry)root(m);
+    while (node) {
+        if (! lo || compare(node->key,lo) >= 0) {
+            iter->stack[iter->depth++] = node;
+            node = node->_left;
+        } else {
+            node = node->_right;
+        }
     }
+    if (iter->depth == 0 || past_end(iter))
+        return NULL;
+    set_current(iter);
+    return iter;
+}
+
+/// initialize a map iterator, positioned on the minimum node.
+// Like `map_iter_range`, this does no allocation.
+// @param iter iterator struct
+// @param m the map
+// @param pkey optional pointer to key variable
+// @param pvalue optional pointer to value variable
+// @return `iter`, or NULL if the map is empty
+MapIter map_iter_init (MapIterStruct *iter, Map *m, void *pkey, void *pvalue) {
+    return map_iter_range(iter,m,NULL,NULL,pkey,pvalue);
+}
+
+/// create a new map iterator positioned on the mininum node.
+// The iterator is freed when it finishes; if you stop early, `unref` it.
+MapIter map_iter_new (Map *m, void *pkey, void *pvalue) {
+    if (root(m) == NULL) // empty map
+        return NULL;
+    MapIter iter = obj_new(MapIterStruct,NULL);
+    map_iter_init(iter,m,pkey,pvalue);
+    iter->owned = true;
     return iter;
 }
 
 /// advance the map iterator to the next node.
+// @return NULL when there are no more nodes
 MapIter map_iter_next (MapIter iter) {
-    PEntry node = iter->node;
-    // basic strategy is to revisit the left branch for the next node in order.
-    // However, if we do have a right node, mark it as visited and go down the left.
-    if (node->_right) {
-        iter->node = node->_right;
-        push_stack(iter,node,true);
-        go_down_left(iter);
-        node = iter->node;
-    } else {// look for an univisited node on the stack
-        PEntry item = pop_stack(iter);
-        while (item) {
-            if (! right_visited(item))
-                break;
-            obj_unref(item);
-            item = pop_stack(iter);
-        }
-        if (item != NULL) { // gotcha!
-            node = (PEntry)item->data;
-            obj_unref(item);
-        } else {// no more stack, we're finished
+    PEntry node = iter->stack[--iter->depth];
+    // the next node is the leftmost one of the right subtree, if any;
+    // otherwise the nearest ancestor we went left from
+    go_down_left(iter,node->_right);
+    if (iter->depth == 0 || past_end(iter)) {
+        if (iter->owned)
             obj_unref(iter);
-            return NULL;
+        return NULL;
+    }
+    set_current(iter);
+    return iter;
+}
+
+/// iterate over the keys from `lo` up to, but not including, `hi`.
+// As with `FOR_MAP`, nothing is allocated.
+// @tparam MapIter var the loop variable
+// @tparam m the map
+// @param lo lowest key, or NULL
+// @param hi key to stop before, or NULL
+// @macro FOR_MAP_RANGE
+
+/// Ordered Queries.
+// Since map keys are ordered, we can ask for the first key not less than a given
+// key, and for keys by their position. The first call to `map_rank` or `map_select`
+// counts the whole map, which is O(n); after that the map keeps its subtree sizes up
+// to date as it changes, and they are O(log n).
+// @section order
+
+/// the first entry whose key is not less than `key`.
+// @return the entry, or NULL if all keys are less
+PEntry map_lower_bound(Map *m, void *key) {
+    ListCmpFun compare = m->kind->compare;
+    PEntry node = (PEntry)root(m), res = NULL;
+    while (node) {
+        if (compare(node->key,key) >= 0) {
+            res = node;
+            node = node->_left;
+        } else {
+            node = node->_right;
         }
-        iter->node = node;
     }
-    iter->key = node->key;
-    iter->value = map_value_data(iter->map,node);
-    if (iter->pkey) {
-        *iter->pkey = iter->key;
-        *iter->pvalue = iter->value;
+    return res;
+}
+
+/// the first entry whose key is greater than `key`.
+// @return the entry, or NULL if no key is greater
+PEntry map_upper_bound(Map *m, void *key) {
+    ListCmpFun compare = m->kind->compare;
+    PEntry node = (PEntry)root(m), res = NULL;
+    while (node) {
+        if (compare(node->key,key) > 0) {
+            res = node;
+            node = node->_left;
+        } else {
+            node = node->_right;
+        }
+    }
+    return res;
+}
+
+/// the number of keys less than `key`.
+// O(log n), once the map keeps its subtree sizes.
+int map_rank(Map *m, void *key) {
+    ListCmpFun compare = m->kind->compare;
+    MapSizes *S = map_sizes(m);
+    PEntry node = (PEntry)root(m);
+    int rank = 0;
+    while (node) {
+        if (compare(node->key,key) < 0) {
+            rank += node_size(S,node->_left) + 1;
+            node = node->_right;
+        } else {
+            node = node->_left;
+        }
+    }
+    return rank;
+}
+
+/// the entry with `k` smaller keys.
+// O(log n), once the map keeps its subtree sizes.
+// @int k zero-based position
+// @return the entry, or NULL if `k` is out of range
+PEntry map_select(Map *m, int k) {
+    if (k < 0 || k >= map_size(m))
+        return NULL;
+    MapSizes *S = map_sizes(m);
+    PEntry node = (PEntry)root(m);
+    for (;;) {
+        int left = node_size(S,node->_left);
+        if (k == left)
+            return node;
+        if (k < left) {
+            node = node->_left;
+        } else {
+            k -= left + 1;
+            node = node->_right;
+        }
     }
-    return iter;
 }
 
 typedef struct MapIterator_ MapIterator;
@@ -512,19 +991,17 @@ struct MapIterator_ {
     bool (*nextpair)(Iterator *iter, void *pkey, void *pval);
     int len;
     MapIter mi;
-    bool finis;
+    MapIterStruct mis;
 };
 
 static bool iterator_map_nextpair(Iterator *iter, void *pkey, void *pval) {
     MapIterator *miter = (MapIterator*)iter;
     MapIter mi = miter->mi;
+    if (! mi)
+        return false;
     *((void**)pkey) = mi->key;
     *((void**)pval) = mi->value;
-    if (miter->finis) {
-        miter->mi = NULL;
-        return false;
-    }
-    miter->finis = map_iter_next(mi) == NULL;
+    miter->mi = map_iter_next(mi);
     return true;
 }
 
@@ -533,18 +1010,13 @@ static bool iterator_map_next(Iterator *iter, void *pval) {
     return iterator_map_nextpair(iter,pval,(void*)&pnone);
 }
 
-static void MapIterator_dispose(MapIterator *iter) {
-    if (! iter->finis) // not already dead...
-        obj_unref(iter->mi);
-}
-
+// the map iterator is part of the Iterator object, so there is only one allocation
 static Iterator* iterator_map_init(const void *o) {
-    MapIterator *iter = obj_new(MapIterator,MapIterator_dispose);
-    iter->mi = map_iter_new((Map*)o,NULL,NULL);
+    MapIterator *iter = obj_new(MapIterator,NULL);
+    iter->mi = map_iter_init(&iter->mis,(Map*)o,NULL,NULL);
     iter->next = iterator_map_next;
     iter->nextpair = iterator_map_nextpair;
     iter->len = map_size((Map*)o);
-    iter->finis = false;
     return (Iterator*)iter;
 }
 
@@ -21,6 +21,10 @@ typedef List Map;
 #endif
 
 #define map_size list_size
+#define map_use_node_slab(m) list_use_node_slab(m)
+
+// maps are balanced, so no tree is deeper than this
+#define MAP_MAX_DEPTH 64
 
 typedef struct MapIter_{
     void **pkey;
@@ -29,7 +33,11 @@ typedef struct MapIter_{
     void *value;
     Map *map;
     PEntry node;
-    List *vstack;
+    bool owned;  // made by map_iter_new
+    bool bounded; // stop before the key `hi`
+    void *hi;
+    int depth;
+    PEntry stack[MAP_MAX_DEPTH];  // nodes still to visit
 } MapIterStruct, *MapIter;
 
 #define map_geti(m,s) ((intptr_t)map_get(m,(void*)(s)))
@@ -41,11 +49,16 @@ Map *map_new_node(bool strkey);
 Map *map_new_str_ptr();
 Map *map_new_str_ref();
 Map *map_new_str_str();
+Map *map_new_istr_ptr();
+Map *map_new_istr_ref();
+Map *map_new_istr_str();
 Map *map_new_ptr_ptr();
 Map *map_new_ptr_ref();
 Map *map_new_ptr_str();
 
 bool map_object (void *obj);
+bool map_owns_values(Map *m);
+void map_clear(Map *m);
 
 PEntry map_first(Map *m);
 void *map_value_data (Map *m, PEntry item);
@@ -53,6 +66,8 @@ void map_free_item(Map *m, PEntry item);
 PEntry map_put_struct(Map *m, void *data);
 PEntry map_put(Map *m, void* key, void *data);
 void map_put_keyvalues(Map *m, MapKeyValue *mkv);
+bool map_put_sorted(Map *m, MapKeyValue *mkv, int n);
+bool map_merge(Map *m, Map *other);
 void *map_get(Map *m, void *key);
 bool map_contains(Map *m, void *key);
 PEntry map_remove(Map *m, void *key) ;
@@ -62,16 +77,26 @@ typedef void (*MapCallback)(void *,PEntry);
 
 void map_visit(void *data, PEntry node, MapCallback fun, int order);
 
+MapIter map_iter_init (MapIterStruct *iter, Map *m, void *pkey, void *pvalue);
 MapIter map_iter_new (Map *m, void *pkey, void *pvalue);
+MapIter map_iter_range (MapIterStruct *iter, Map *m, void *lo, void *hi, void *pkey, void *pvalue);
 MapIter map_iter_next (MapIter iter);
 
+PEntry map_lower_bound(Map *m, void *key);
+PEntry map_upper_bound(Map *m, void *key);
+int map_rank(Map *m, void *key);
+PEntry map_select(Map *m, int k);
+
 #define map_gets(m,key) map_get(m,(void*)key)
 #define map_puts(m,key,val) map_put(m,(void*)key,(void*)val)
 
-#define FOR_MAP(iter,map) for (MapIter iter = map_iter_new(map,NULL,NULL);\
+#define FOR_MAP(iter,map) for (MapIterStruct iter##_s_, *iter = map_iter_init(&iter##_s_,map,NULL,NULL);\
 iter; iter = map_iter_next(iter))
 
-#define FOR_MAP_KEYVALUE(k,v,map) for (MapIter iter_ = map_iter_new(map,&k,&v);\
+#define FOR_MAP_RANGE(iter,map,lo,hi) for (MapIterStruct iter##_s_, \
+*iter = map_iter_range(&iter##_s_,map,(void*)(lo),(void*)(hi),NULL,NULL); iter; iter = map_iter_next(iter))
+
+#define FOR_MAP_KEYVALUE(k,v,map) for (MapIterStruct iter_s_, *iter_ = map_iter_init(&iter_s_,map,&k,&v);\
 iter_; iter_ = map_iter_next(iter_))
 
 
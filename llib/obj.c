@@ -7,8 +7,8 @@
 /***
 ### Support for Refcounted Objects.
 
-These are (currently) allocated with `malloc` and freed with `free`, but in addition always
-carry a refcount (see `obj_refcount`).  `obj_ref` increments this count, and `obj_unref`
+Small objects are allocated from size classes (see `obj_slab_stats`), larger ones with
+`malloc`, but in addition they always carry a refcount (see `obj_refcount`).  `obj_ref` increments this count, and `obj_unref`
 decrements this count; when the count becomes zero, the object is freed.  If the object
 has an associated dispose function specified in `obj_new`, then this will be called first.
 
@@ -47,7 +47,22 @@ to a sequence. A sequence `s` is a pointer to an array of T.  The underlying
 array can always be accessed with `*s`, and the array will be sized-to-fit when
 `seq_array_ref` is called.
 
-See `test-obj.c` and `test-seq.c`
+Allocation statistics are always kept for each type: live objects, total
+allocations, live and peak bytes, and array lengths. See `obj_type_stats`,
+and `value_type_stats` for the same as a value which can be written out as JSON.
+Allocation sites can be profiled by sampling; see `obj_profile_start`.
+
+When built with `LLIB_THREADS`, the type registry is protected by a lock, and objects
+may be shared between threads. Refcounts are _biased_: the thread which created an
+object is its owner, and updates its count without atomic operations, while other
+threads update a separate shared count atomically.  The object is freed when both
+counts have gone. A reference may be released by another thread than the one which
+took it, but only after `obj_transfer` has handed the owner's references over to the
+shared count. Objects which are going to be passed to other threads, such as parsed
+documents, may instead be created without an owner inside `obj_shared_scope`.
+Object pools and arenas belong to the thread which created them.
+
+See `test-obj.c`, `test-seq.c` and `test-threads.c`
 
 @module obj
 */
@@ -60,7 +75,34 @@ See `test-obj.c` and `test-seq.c`
 #include <assert.h>
 #include <stdarg.h>
 
-#define MAX_PTRS 10000
+#ifdef LLIB_THREADS
+#ifdef _WIN32
+#include <windows.h>
+typedef SRWLOCK ObjLock;
+#define OBJ_LOCK_INIT SRWLOCK_INIT
+#define obj_lock_init(l) InitializeSRWLock(l)
+#define obj_lock(l) AcquireSRWLockExclusive(l)
+#define obj_unlock(l) ReleaseSRWLockExclusive(l)
+#else
+#include <pthread.h>
+typedef pthread_mutex_t ObjLock;
+#define OBJ_LOCK_INIT PTHREAD_MUTEX_INITIALIZER
+#define obj_lock_init(l) pthread_mutex_init(l,NULL)
+#define obj_lock(l) pthread_mutex_lock(l)
+#define obj_unlock(l) pthread_mutex_unlock(l)
+#endif
+static ObjLock s_lock = OBJ_LOCK_INIT;
+#define lock_obj() obj_lock(&s_lock)
+#define unlock_obj() obj_unlock(&s_lock)
+static ObjLock s_intern_lock = OBJ_LOCK_INIT;
+#define lock_intern() obj_lock(&s_intern_lock)
+#define unlock_intern() obj_unlock(&s_intern_lock)
+#else
+#define lock_obj()
+#define unlock_obj()
+#define lock_intern()
+#define unlock_intern()
+#endif
 
 /// standard for-loop.
 // @param i loop variable.
@@ -77,71 +119,226 @@ See `test-obj.c` and `test-seq.c`
 // number of created 'live' objects -- access with obj_kount()
 static int kount = 0;
 
-#ifdef LLIB_PTR_LIST
 // Generally one can't depend on malloc or other allocators returning pointers
-// within a given range. So we keep an array of 'our' pointers, which we know
-// for a fact were allocated using `new_obj`
-static int max_p = 0;
-static void *our_ptrs[MAX_PTRS];
-
-static int our_ptr_idx(void *p) {
-    FOR(i,max_p) {
-        if (our_ptrs[i] == p)
-            return i;
-    }
-    return -1;
-}
-
-static void add_our_ptr(void *p) {
-    // look for first empty slot, or a new one if none found.
-    int idx = our_ptr_idx(NULL);
-    if (idx == -1) {
-        our_ptrs[max_p] = p;
-        ++max_p;
-        assert(max_p < MAX_PTRS);
-    } else {
-        our_ptrs[idx] = p;
+// within a given range. So we keep a set of 'our' pointers (object headers), which we know
+// for a fact were allocated using `new_obj`. This is an open-addressed hash table,
+// so checking a pointer costs the same however many objects there are.
+// With LLIB_THREADS, the set is split into shards, each with its own lock.
+// Objects from the size classes or in arenas are not put in the set, since the slab
+// allocator and the arenas can tell us themselves whether they are live.
+// The set also remembers the size of each object, for the type statistics,
+// and any block attached to the object with `obj_attachment_`.
+typedef struct PtrEntry_ {
+    void *p;
+    int size;
+    void *extra;
+} PtrEntry;
+
+typedef struct PtrSet_ {
+    PtrEntry *ptrs;
+    unsigned int mask, count;
+#ifdef LLIB_THREADS
+    ObjLock lock;
+#endif
+} PtrSet;
+
+#ifdef LLIB_THREADS
+#define PTR_SHARDS 64
+#define shard_lock(ps) obj_lock(&(ps)->lock)
+#define shard_unlock(ps) obj_unlock(&(ps)->lock)
+#else
+#define PTR_SHARDS 1
+#define shard_lock(ps)
+#define shard_unlock(ps)
+#endif
+
+static PtrSet s_ptrs[PTR_SHARDS];
+static bool s_ptrs_ready;
+
+#define hash_ptr(p) ((unsigned int)((uintptr_t)(p) >> 4) * 2654435761u)
+// the low bits of the hash pick a slot, the high bits a shard
+#define shard_of(h) (&s_ptrs[((h) >> 26) % PTR_SHARDS])
+
+static void ptrs_initialize() {
+#ifdef LLIB_THREADS
+    FOR(i,PTR_SHARDS)
+        obj_lock_init(&s_ptrs[i].lock);
+#endif
+    obj_atomic_store_(&s_ptrs_ready,true);
+}
+
+static PtrEntry *ptrset_insert(PtrSet *ps, void *p, int size, unsigned int h);
+
+static void ptrset_grow(PtrSet *ps) {
+    PtrEntry *old = ps->ptrs;
+    unsigned int oldn = old ? ps->mask + 1 : 0;
+    unsigned int n = old ? 2*oldn : 1024;
+    ps->ptrs = (PtrEntry*)calloc(n,sizeof(PtrEntry));
+    ps->mask = n - 1;
+    ps->count = 0;
+    for (unsigned int i = 0; i < oldn; i++) {
+        if (old[i].p)
+            ptrset_insert(ps,old[i].p,old[i].size,hash_ptr(old[i].p))->extra = old[i].extra;
     }
-    ++kount;
+    free(old);
 }
 
-static void remove_our_ptr(void *p) {
-    int ptr_idx = our_ptr_idx(p);
-    assert(ptr_idx != -1); // might not be one of ours!
-    our_ptrs[ptr_idx] = NULL;
-    --kount;
+static PtrEntry *ptrset_insert(PtrSet *ps, void *p, int size, unsigned int h) {
+    if (! ps->ptrs || 2*(ps->count + 1) > ps->mask + 1)
+        ptrset_grow(ps);
+    while (ps->ptrs[h & ps->mask].p)
+        ++h;
+    PtrEntry *e = &ps->ptrs[h & ps->mask];
+    e->p = p;
+    e->size = size;
+    e->extra = NULL;
+    ++ps->count;
+    return e;
 }
-#define our_ptr(p) (our_ptr_idx(p) != -1)
-#else
-// if the libc supports, here is a simpler scheme which assumes that 'our' pointers are always
-// between the lowest and highest pointer value allocated so far.  This scheme of course gives a false
-// positive if a pointer was just allocated with plain malloc, so be careful about using obj_unref
-static void *low_ptr, *high_ptr;
-
-static void add_our_ptr(void *p) {
-    if (! low_ptr) {
-        low_ptr = p;
-        high_ptr = p;
-    } else {
-        if (p < low_ptr)
-            low_ptr = p;
-        else if (p > high_ptr)
-            high_ptr = p;
+
+static int ptrset_find(PtrSet *ps, void *p, unsigned int h) {
+    if (! ps->ptrs)
+        return -1;
+    for (;; ++h) {
+        void *q = ps->ptrs[h & ps->mask].p;
+        if (q == p)
+            return h & ps->mask;
+        if (q == NULL)
+            return -1;
     }
-    ++kount;
 }
 
-static int our_ptr (void *p) {
-    return p >= low_ptr && p <= high_ptr;
+// linear probing lets us delete without tombstones, by shifting any
+// following entries of the probe run back into the hole.
+static void ptrset_remove(PtrSet *ps, unsigned int hole) {
+    unsigned int i = hole;
+    --ps->count;
+    for (;;) {
+        i = (i + 1) & ps->mask;
+        void *q = ps->ptrs[i].p;
+        if (q == NULL)
+            break;
+        unsigned int home = hash_ptr(q) & ps->mask;
+        if (((i - home) & ps->mask) >= ((i - hole) & ps->mask)) {
+            ps->ptrs[hole] = ps->ptrs[i];
+            hole = i;
+        }
+    }
+    ps->ptrs[hole].p = NULL;
 }
 
-static void remove_our_ptr(void *p) {
-    --kount;
+int obj_slab_owns_(void *p);
+int obj_slab_live_(void **out, int max);
+int obj_slab_size_(void *p);
+int obj_arena_owns_(void *p);
+
+// arena objects never get here
+static void add_our_ptr(void *p, int size) {
+    if (((ObjHeader*)p)->_alloc != OBJ_ALLOC_SLAB) {
+        unsigned int h = hash_ptr(p);
+        PtrSet *ps = shard_of(h);
+        shard_lock(ps);
+        ptrset_insert(ps,p,size,h);
+        shard_unlock(ps);
+    }
+    obj_atomic_add_(&kount,1);
+}
+
+static bool our_ptr(void *p) {
+    if (! obj_atomic_load_(&s_ptrs_ready))
+        return false;
+    int owned = obj_slab_owns_(p);
+    if (owned != -1)
+        return owned;
+    owned = obj_arena_owns_(p);
+    if (owned != -1)
+        return owned;
+    unsigned int h = hash_ptr(p);
+    PtrSet *ps = shard_of(h);
+    shard_lock(ps);
+    int idx = ptrset_find(ps,p,h);
+    shard_unlock(ps);
+    return idx != -1;
+}
+
+// returns the size the object was allocated with
+// (slab objects leave the allocator's live set when they are freed)
+static int remove_our_ptr(void *p) {
+    int size;
+    if (((ObjHeader*)p)->_alloc != OBJ_ALLOC_SLAB) {
+        unsigned int h = hash_ptr(p);
+        PtrSet *ps = shard_of(h);
+        shard_lock(ps);
+        int idx = ptrset_find(ps,p,h);
+        assert(idx != -1); // might not be one of ours!
+        size = ps->ptrs[idx].size;
+        free(ps->ptrs[idx].extra);
+        ptrset_remove(ps,idx);
+        shard_unlock(ps);
+    } else {
+        size = obj_slab_size_(p);
+    }
+    obj_atomic_add_(&kount,-1);
+    return size;
 }
-#endif
 
 int obj_kount() { return kount; }
 
+// A block from malloc can be attached to an object, to cache something worked
+// out from it; it is freed with the object, and also when the object moves,
+// since it can then have changed. `fn` gets a pointer to the attachment
+// (initially NULL) while the object's shard is locked, so it must not call
+// anything which looks up objects. Objects in slabs or arenas have no entry to attach to,
+// so this returns false for them, and for pointers which are not ours.
+bool obj_attachment_(const void *P, ObjAttachFn fn, void *arg) {
+    if (! obj_atomic_load_(&s_ptrs_ready))
+        return false;
+    ObjHeader *p = obj_header_(P);
+    if (obj_slab_owns_(p) != -1 || obj_arena_owns_(p) != -1)
+        return false;
+    unsigned int h = hash_ptr(p);
+    PtrSet *ps = shard_of(h);
+    shard_lock(ps);
+    int idx = ptrset_find(ps,p,h);
+    if (idx != -1)
+        fn(&ps->ptrs[idx].extra,arg);
+    shard_unlock(ps);
+    return idx != -1;
+}
+
+#ifdef LLIB_THREADS
+// thread ids start at one; zero means that an object has no owner
+static unsigned int s_threads;
+static LLIB_TLS unsigned int s_thread_id;
+static LLIB_TLS int s_shared_scopes;
+
+static unsigned int thread_id() {
+    if (! s_thread_id)
+        s_thread_id = obj_atomic_add_(&s_threads,1);
+    return s_thread_id;
+}
+
+static void init_refs(ObjHeader *h) {
+    if (s_shared_scopes) {
+        h->_ref = 0;
+        h->_owner = 0;
+        h->_shared = 2 + OBJ_MERGED;
+    } else {
+        h->_ref = 1;
+        h->_owner = thread_id();
+        h->_shared = 0;
+    }
+}
+#define ref_count(h) ((h)->_ref + (obj_atomic_load_(&(h)->_shared) >> 1))
+// is the calling thread the only one referring to this object?
+#define sole_ref(h) ((h)->_ref == 1 && (h)->_owner == thread_id() && \
+    obj_atomic_load_(&(h)->_shared) == 0)
+#else
+#define init_refs(h) ((h)->_ref = 1)
+#define ref_count(h) ((h)->_ref)
+#define sole_ref(h) ((h)->_ref == 1)
+#endif
+
 #ifdef LLIB_DEBUG
 static bool s_do_free=true;
 #endif
@@ -159,22 +356,139 @@ ObjAllocator obj_default_allocator = {
 };
 
 // shared with pool.c
-DisposeFn _pool_filter, _pool_cleaner;
+LLIB_TLS DisposeFn _pool_filter, _pool_cleaner;
+LLIB_TLS void (*_pool_mover)(void *P, void *NP);
+
+// shared with slab.c
+void *obj_slab_alloc_(int size);
+void obj_slab_free_(void *p);
+
+// shared with arena.c
+LLIB_TLS void *(*_arena_alloc)(int size);
+int obj_arena_size_(ObjHeader *h);
+void obj_arena_keep_(void *P);
+
+// shared with profile.c
+extern int _obj_profiling, _obj_profile_samples;
+void obj_profile_alloc_(void *obj, const char *type, int size);
+void obj_profile_free_(void *obj);
+void obj_profile_move_(uintptr_t obj, void *nobj);
 
 #define PTR_FROM_HEADER(h) ((void*)(((ObjHeader*)(h))+1))
 #define HEADER_FROM_PTR(P) ((ObjHeader*)P-1)
 
-// all llib objects are allocated here
-static ObjHeader *new_obj(int size, ObjType *t) {
+#define LLIB_TYPE_MAX 4096
+
+// Allocation statistics are always kept for each type. Every thread counts
+// into its own table, which only it writes, and `obj_type_stats` adds up the tables
+// of all threads. A table is split into blocks of types, allocated when a type
+// is first counted, so that blocks never move under a reader. Tables are
+// kept after their thread exits, since the counts still matter.
+#define COUNT_BLOCK 16
+
+typedef struct TypeCounts_ {
+    long long allocs, frees;
+    long long bytes, peak; // peak is of the bytes counted by this thread
+    long long lengths[OBJ_LEN_BUCKETS];
+} TypeCounts;
+
+typedef struct ThreadCounts_ {
+    struct ThreadCounts_ *next;
+    TypeCounts *blocks[LLIB_TYPE_MAX/COUNT_BLOCK];
+} ThreadCounts;
+
+static ThreadCounts *s_all_counts;
+static LLIB_TLS ThreadCounts *s_counts;
+
+// only the owning thread changes its counts, but other threads may read them
+#define count_incr(c,n) obj_atomic_store_(&(c),(c)+(n))
+
+static TypeCounts *type_counts(int type) {
+    ThreadCounts *tc = s_counts;
+    if (! tc) {
+        tc = (ThreadCounts*)calloc(1,sizeof(ThreadCounts));
+        do {
+            tc->next = obj_atomic_load_(&s_all_counts);
+        } while (! obj_atomic_cas_ptr_(&s_all_counts,tc->next,tc));
+        s_counts = tc;
+    }
+    TypeCounts *b = tc->blocks[type / COUNT_BLOCK];
+    if (! b) {
+        b = (TypeCounts*)calloc(COUNT_BLOCK,sizeof(TypeCounts));
+        obj_atomic_store_(&tc->blocks[type / COUNT_BLOCK],b);
+    }
+    return &b[type % COUNT_BLOCK];
+}
+
+// `len` is the length of a new array, or -1 for other objects
+static void count_alloc(int type, int size, int len) {
+    TypeCounts *c = type_counts(type);
+    count_incr(c->allocs,1);
+    count_incr(c->bytes,size);
+    if (c->bytes > c->peak)
+        obj_atomic_store_(&c->peak,c->bytes);
+    if (len >= 0) {
+        int b;
+#ifdef __GNUC__
+        b = len ? 32 - __builtin_clz(len) : 0;
+#else
+        for (b = 0; len >> b; b++) ;
+#endif
+        if (b >= OBJ_LEN_BUCKETS)
+            b = OBJ_LEN_BUCKETS - 1;
+        count_incr(c->lengths[b],1);
+    }
+}
+
+static void count_free(int type, int size) {
+    TypeCounts *c = type_counts(type);
+    count_incr(c->frees,1);
+    count_incr(c->bytes,-size);
+}
+
+static void count_resize(int type, int oldsize, int size) {
+    TypeCounts *c = type_counts(type);
+    count_incr(c->bytes,size - oldsize);
+    if (c->bytes > c->peak)
+        obj_atomic_store_(&c->peak,c->bytes);
+}
+
+// all llib objects are allocated here; `len` is -1 unless this is a new array
+static ObjHeader *new_obj(int size, ObjType *t, int len) {
     size += sizeof(ObjHeader);
     void *obj;
+    int kind = OBJ_ALLOC_HEAP;
 
     if (! t->alloc) {
-        obj = malloc(size);
+        if (_arena_alloc) {
+            obj = _arena_alloc(size);
+            kind = OBJ_ALLOC_ARENA;
+        } else {
+            obj = obj_slab_alloc_(size);
+            if (obj)
+                kind = OBJ_ALLOC_SLAB;
+            else
+                obj = malloc(size);
+        }
     } else {
         obj = t->alloc->alloc(t->alloc,size);
+        kind = OBJ_ALLOC_CUSTOM;
+    }
+    ((ObjHeader*)obj)->_alloc = kind;
+    // arena objects are not counted or tracked one by one, and are released
+    // with the arena, not by any pool. The arena only needs to know about
+    // those which must be disposed
+    if (kind == OBJ_ALLOC_ARENA) {
+        if (len < 0 && t->dtor)
+            obj_arena_keep_(PTR_FROM_HEADER(obj));
+        return (ObjHeader *)obj;
     }
-    add_our_ptr(obj);
+    if (kind == OBJ_ALLOC_SLAB)
+        size = obj_slab_size_(obj);
+    add_our_ptr(obj,size);
+    count_alloc(t->idx,size,len);
+    if (obj_atomic_load_(&_obj_profiling))
+        obj_profile_alloc_(obj,t->name,size);
 #ifdef LLIB_DEBUG
     ++t->instances;
 #endif
@@ -191,7 +505,7 @@ int obj_refcount (const void *p)
     if (p == NULL) return -1;
     ObjHeader *pr = obj_header_(p);
     if (our_ptr(pr)) {
-        return pr->_ref;
+        return ref_count(pr);
     } else {
         return -1;
     }
@@ -216,8 +530,6 @@ int obj_refcount (const void *p)
 // @within RTTI
 
 // Type descriptors are kept in an array
-#define LLIB_TYPE_MAX 4096
-
 ObjType obj_types[LLIB_TYPE_MAX];
 static int obj_types_size = 8;
 
@@ -237,37 +549,84 @@ const char *obj_typename(const void *p) {
     return obj_type_(obj_header_(p))->name;
 }
 
+// Types are looked up by dispose function, or by name if there is none.
+// Both are hashed into open-addressed tables of type indices (plus one, so that
+// zero means an empty slot). As with a linear search, the first type
+// registered with a given name or dispose function wins.
+#define TYPE_HASH_SIZE (2*LLIB_TYPE_MAX)
+#define TYPE_HASH_MASK (TYPE_HASH_SIZE-1)
+
+static uint16_t types_by_name[TYPE_HASH_SIZE], types_by_dtor[TYPE_HASH_SIZE];
+
+static unsigned int hash_name(const char *s) {
+    unsigned int h = 2166136261u;
+    for (; *s; ++s)
+        h = (h ^ (unsigned char)*s) * 16777619u;
+    return h;
+}
+
+static unsigned int hash_dtor(DisposeFn dtor) {
+    uintptr_t k = (uintptr_t)dtor;
+    return (unsigned int)(k >> 4) * 2654435761u;
+}
+
 static OTP type_from_dtor(const char *name, DisposeFn dtor) {
     if (dtor) {
-        for(OTP pt = obj_types; pt->name; ++pt) {
-            if (pt->dtor == dtor)
-                return pt;
+        for (unsigned int i = hash_dtor(dtor); ; ++i) {
+            int idx = types_by_dtor[i & TYPE_HASH_MASK];
+            if (idx == 0)
+                return NULL;
+            if (obj_types[idx-1].dtor == dtor)
+                return &obj_types[idx-1];
         }
     } else { // no dispose fun, so let's match by name
-        for(OTP pt = obj_types; pt->name; ++pt) {
-            if (strcmp(pt->name,name) == 0)
-                return pt;
+        for (unsigned int i = hash_name(name); ; ++i) {
+            int idx = types_by_name[i & TYPE_HASH_MASK];
+            if (idx == 0)
+                return NULL;
+            if (strcmp(obj_types[idx-1].name,name) == 0)
+                return &obj_types[idx-1];
         }
     }
-    return NULL;
+}
+
+static void index_type(OTP t) {
+    if (! type_from_dtor(t->name,NULL)) {
+        unsigned int i = hash_name(t->name);
+        while (types_by_name[i & TYPE_HASH_MASK])
+            ++i;
+        types_by_name[i & TYPE_HASH_MASK] = t->idx + 1;
+    }
+    if (t->dtor && ! type_from_dtor(t->name,t->dtor)) {
+        unsigned int i = hash_dtor(t->dtor);
+        while (types_by_dtor[i & TYPE_HASH_MASK])
+            ++i;
+        types_by_dtor[i & TYPE_HASH_MASK] = t->idx + 1;
+    }
 }
 
 int obj_typeof_(const char *name) {
+    lock_obj();
     OTP t = type_from_dtor(name,NULL);
+    unlock_obj();
     if (! t)
         return -1;
     return t->idx;
 }
 
 static OTP new_type(int size, const char *type, DisposeFn dtor) {
+    assert(obj_types_size < LLIB_TYPE_MAX - 1);
     OTP t = &obj_types[obj_types_size];
     t->name = type;
     t->dtor = dtor;
     t->interfaces = NULL;
     t->mlem = size;
-    t->idx = obj_types_size++;
+    t->idx = obj_types_size;
     // just in case...
-    obj_types[obj_types_size].name = NULL;
+    obj_types[obj_types_size+1].name = NULL;
+    index_type(t);
+    // only now can other threads see the new type
+    obj_atomic_store_(&obj_types_size,obj_types_size+1);
     return t;
 }
 
@@ -287,7 +646,10 @@ static ObjType obj_types_initialized[] = {
 
 static void initialize_types() {
     initialized = true;
+    ptrs_initialize();
     memcpy(obj_types,obj_types_initialized,sizeof(obj_types_initialized));
+    FOR(i,obj_types_size)
+        index_type(&obj_types[i]);
 }
 
 /// allocate a new type
@@ -298,10 +660,13 @@ static void initialize_types() {
 // @within New
 
 int obj_new_type_(int size, const char *type, DisposeFn dtor) {
+    lock_obj();
     if (! initialized) {
         initialize_types();
     }
-    return new_type(size,type,dtor)->idx;
+    int idx = new_type(size,type,dtor)->idx;
+    unlock_obj();
+    return idx;
 }
 
 /// allocate a new refcounted object.
@@ -312,9 +677,9 @@ int obj_new_type_(int size, const char *type, DisposeFn dtor) {
 // @within New
 
 static void *obj_from_type(OTP t) {
-    ObjHeader *h = new_obj(t->mlem,t);
+    ObjHeader *h = new_obj(t->mlem,t,-1);
     h->_len = 0;
-    h->_ref = 1;
+    init_refs(h);
     h->is_array = 0;
     h->is_ref_container = 0;
     h->type = t->idx;
@@ -325,21 +690,34 @@ static void *obj_from_type(OTP t) {
     return P;
 }
 
-void *obj_new_(int size, const char *type, DisposeFn dtor) {
+// the registry only grows, and existing entries never move, so the lock is
+// only needed while looking up or adding types, not while using them.
+static OTP type_resolve(int size, const char *type, DisposeFn dtor) {
+    lock_obj();
     if (! initialized) {
         initialize_types();
     }
     OTP t = type_from_dtor(type,dtor);
     if (! t)
         t = new_type(size,type,dtor);
+    unlock_obj();
+    return t;
+}
 
-    return obj_from_type(t);
+void *obj_new_(int size, const char *type, DisposeFn dtor) {
+    return obj_from_type(type_resolve(size,type,dtor));
+}
+
+// the type index of an object type, creating it if needed.
+// `obj_new` and `array_new` cache this at each call site, where possible.
+int obj_type_resolve_(int size, const char *type, DisposeFn dtor) {
+    return type_resolve(size,type,dtor)->idx;
 }
 
 /// allocate a new object from type.
 // @within New
 void *obj_new_from_type(int ti) {
-    if (ti < 0 || ti >= obj_types_size)
+    if (ti < 0 || ti >= obj_atomic_load_(&obj_types_size))
         return NULL;
     OTP t = &obj_types[ti];
     return obj_from_type(t);
@@ -361,6 +739,78 @@ bool obj_is_instance(const void *P, const char *name) {
     return strcmp(obj_typename(P),name) == 0;
 }
 
+// the largest total of live bytes seen for each type when stats were taken
+static long long s_peaks[LLIB_TYPE_MAX];
+
+/// allocation statistics for each type.
+// Returns an array of `ObjTypeStats`. Unless `all` is true, only
+// types which have been allocated are included. With `LLIB_THREADS`, the
+// counts of all threads are added up; `peak` is then the largest of the peaks of
+// any one thread and the totals seen by calls to this function.
+// @bool all include types which have never been allocated
+// @within Allocation
+ObjTypeStats *obj_type_stats(bool all) {
+    int ntypes = obj_atomic_load_(&obj_types_size);
+    TypeCounts *sums = (TypeCounts*)calloc(ntypes,sizeof(TypeCounts));
+    int n = 0;
+    for (ThreadCounts *tc = obj_atomic_load_(&s_all_counts); tc; tc = tc->next) {
+        FOR(i,ntypes) {
+            TypeCounts *c = obj_atomic_load_(&tc->blocks[i / COUNT_BLOCK]);
+            if (! c)
+                continue;
+            c += i % COUNT_BLOCK;
+            TypeCounts *sum = &sums[i];
+            sum->allocs += obj_atomic_load_(&c->allocs);
+            sum->frees += obj_atomic_load_(&c->frees);
+            sum->bytes += obj_atomic_load_(&c->bytes);
+            long long peak = obj_atomic_load_(&c->peak);
+            if (peak > sum->peak)
+                sum->peak = peak;
+            FOR(k,OBJ_LEN_BUCKETS)
+                sum->lengths[k] += obj_atomic_load_(&c->lengths[k]);
+        }
+    }
+    lock_obj();
+    FOR(i,ntypes) {
+        TypeCounts *sum = &sums[i];
+        if (sum->bytes > s_peaks[i])
+            s_peaks[i] = sum->bytes;
+        if (s_peaks[i] > sum->peak)
+            sum->peak = s_peaks[i];
+        if (all || sum->allocs > 0)
+            ++n;
+    }
+    unlock_obj();
+    ObjTypeStats *res = array_new(ObjTypeStats,n);
+    ObjTypeStats *st = res;
+    FOR(i,ntypes) {
+        TypeCounts *sum = &sums[i];
+        if (! (all || sum->allocs > 0))
+            continue;
+        st->name = obj_types[i].name;
+        st->type = i;
+        st->live = sum->allocs - sum->frees;
+        st->allocs = sum->allocs;
+        st->bytes = sum->bytes;
+        st->peak = sum->peak;
+        memcpy(st->lengths,sum->lengths,sizeof(st->lengths));
+        ++st;
+    }
+    free(sums);
+    return res;
+}
+
+/// allocation statistics of a type.
+// @string name name of type
+// @int type index of type
+// @int live number of live objects
+// @int allocs number of objects ever allocated
+// @int bytes memory taken by the live objects, including headers
+// @int peak highest value of `bytes`
+// @int lengths counts of arrays by length, in powers of two: 0, 1, 2-3, 4-7, ...
+// @table ObjTypeStats
+// @within Allocation
+
 /// dynamically cast object to type.
 // Uses `obj_is_instance`
 // @param T type name
@@ -371,7 +821,7 @@ bool obj_is_instance(const void *P, const char *name) {
 // If they are arrays of refcounted objects, then
 // this has to unref those objects. For structs,
 // there may be an explicit destructor.
-static void obj_free_(ObjHeader *h, const void *P) {
+static void obj_dispose_(ObjHeader *h, const void *P) {
     OTP t = obj_type_(h);
     if (h->is_array) { // arrays may be reference containers
         if (h->is_ref_container) {
@@ -384,28 +834,120 @@ static void obj_free_(ObjHeader *h, const void *P) {
         if (t->dtor)
           t->dtor((void*)P);
     }
+}
 
-    remove_our_ptr(h);
+static void obj_free_(ObjHeader *h, const void *P) {
+    OTP t = obj_type_(h);
+    obj_dispose_(h,P);
+    count_free(h->type,remove_our_ptr(h));
+    if (obj_atomic_load_(&_obj_profile_samples))
+        obj_profile_free_(h);
 
 #ifdef LLIB_DEBUG
     --t->instances;
 #endif
 
-    // if the object pool is active, then remove our pointer from it!
-    if (_pool_cleaner)
-        _pool_cleaner((void*)P);
-
-    // the object's type might have a custom allocator
-    if (t->alloc) {
+    // the object's type might have a custom allocator; otherwise it
+    // comes from the size classes or from malloc
+    if (h->_alloc == OBJ_ALLOC_CUSTOM) {
         t->alloc->free(t->alloc,h);
     } else {
 #ifdef LLIB_DEBUG
         if (s_do_free)
 #endif
-            free(h);
+        {
+            if (h->_alloc == OBJ_ALLOC_SLAB)
+                obj_slab_free_(h);
+            else if (h->_alloc == OBJ_ALLOC_HEAP)
+                free(h);
+        }
+    }
+}
+
+// Objects whose count has gone to zero are freed by the outermost release;
+// any objects which die meanwhile (elements of ref arrays, or things released by
+// dispose functions) are put on a queue, so that freeing a deep structure does
+// not recurse. In deferred mode, dead objects are only freed by `obj_collect`.
+static LLIB_TLS void **s_dead;
+static LLIB_TLS int s_dead_head, s_dead_tail, s_dead_cap;
+static LLIB_TLS bool s_releasing, s_deferred;
+
+static void push_dead(const void *P) {
+    if (s_dead_tail == s_dead_cap) {
+        int n = s_dead_tail - s_dead_head;
+        if (s_dead_head > s_dead_cap/2) { // plenty of room at the front
+            memmove(s_dead,s_dead+s_dead_head,n*sizeof(void*));
+            s_dead_head = 0;
+            s_dead_tail = n;
+        } else {
+            s_dead_cap = s_dead_cap ? 2*s_dead_cap : 256;
+            s_dead = (void**)realloc(s_dead,s_dead_cap*sizeof(void*));
+        }
+    }
+    s_dead[s_dead_tail++] = (void*)P;
+}
+
+// free up to `budget` queued objects (all of them if negative)
+static int drain_dead(int budget) {
+    s_releasing = true;
+    while (s_dead_head < s_dead_tail && budget != 0) {
+        void *P = s_dead[s_dead_head++];
+        obj_free_(obj_header_(P),P);
+        if (budget > 0)
+            --budget;
+    }
+    int left = s_dead_tail - s_dead_head;
+    if (left == 0) {
+        s_dead_head = s_dead_tail = 0;
+        // don't hang on to a big queue after freeing a big structure
+        if (s_dead_cap > 4096) {
+            free(s_dead);
+            s_dead = NULL;
+            s_dead_cap = 0;
+        }
+    }
+    s_releasing = false;
+    return left;
+}
+
+static void release_obj(ObjHeader *h, const void *P) {
+#ifdef LLIB_DEBUG_VERBOSE
+    fprintf(stderr,"freed %p\n",P);
+#endif
+    // if the object pool is active, then remove our pointer from it!
+    if (_pool_cleaner)
+        _pool_cleaner((void*)P);
+    if (s_releasing || s_deferred) {
+        push_dead(P);
+    } else {
+        s_releasing = true;
+        obj_free_(h,P);
+        drain_dead(-1);
     }
 }
 
+/// free dead objects in batches.
+// Normally objects are freed as soon as their refcount goes to zero. If `on` is true,
+// then they are only freed by `obj_collect`, so that releasing a big structure need not
+// cause a long pause.  Switching deferred mode off frees any remaining dead objects.
+// @within References
+void obj_defer_free(bool on) {
+    s_deferred = on;
+    if (! on && ! s_releasing)
+        drain_dead(-1);
+}
+
+/// free at most `budget` dead objects.
+// Freeing an object may release others, which are freed in later batches.
+// A negative budget means no limit.
+// @treturn int number of dead objects still waiting to be freed
+// @within References
+int obj_collect(int budget) {
+    if (s_releasing)
+        return s_dead_tail - s_dead_head;
+    return drain_dead(budget);
+}
+
 // Reference counting
 
 /// increase reference count (`ref`).
@@ -419,6 +961,14 @@ void obj_incr_(const void *P) {
     // if the object pool is active, then remove our pointer from it!
 #ifdef LLIB_DEBUG_VERBOSE
     fprintf(stderr,"+ref %p\n",P);
+#endif
+    if (h->_alloc == OBJ_ALLOC_ARENA) // arena objects are not refcounted
+        return;
+#ifdef LLIB_THREADS
+    if (obj_atomic_load_(&h->_owner) != thread_id()) {
+        obj_atomic_add_(&h->_shared,2);
+        return;
+    }
 #endif
     if (_pool_cleaner && h->_ref == 1) {
         _pool_cleaner((void*)P);
@@ -437,24 +987,142 @@ void obj_unref(const void *P) {
 #ifdef LLIB_DEBUG_VERBOSE
     fprintf(stderr,"-ref %p\n",P);
 #endif
-    // this check is only really useful if LLIB_PTR_LIST is used
     if (! our_ptr(h)) {
         fprintf(stderr,"llib: unref of non ref-counted pointer\n");
         abort();
     }
     // catches already unreferenced pointers...
-    if (h->_ref == 0) {
+    if (ref_count(h) == 0) {
         fprintf(stderr,"llib: unref of dead pointer\n");
         abort();
     }
 #endif
-    --(h->_ref);
-    if (h->_ref == 0) {
-#ifdef LLIB_DEBUG_VERBOSE
-        fprintf(stderr,"freed %p\n",P);
+    if (h->_alloc == OBJ_ALLOC_ARENA) // released with the arena
+        return;
+#ifdef LLIB_THREADS
+    if (obj_atomic_load_(&h->_owner) != thread_id()) {
+        // the last shared reference goes after the owner has let go
+        if (obj_atomic_add_(&h->_shared,-2) == OBJ_MERGED)
+            release_obj(h,P);
+        return;
+    }
+    if (--(h->_ref) == 0) {
+        // the owner has let go; other threads may still refer to the object
+        obj_atomic_store_(&h->_owner,0);
+        if (obj_atomic_or_(&h->_shared,OBJ_MERGED) == 0)
+            release_obj(h,P);
+    }
+#else
+    if (--(h->_ref) == 0)
+        release_obj(h,P);
 #endif
-        obj_free_(h,P);
+}
+
+#ifdef LLIB_THREADS
+/// hand over the calling thread's references to an object.
+// The owner must call this before passing an object to another thread which
+// will release it. The object leaves any object pool, and from now on every
+// thread updates its refcount atomically. Returns the object.
+// The elements of reference arrays are transferred as well, but you must
+// transfer the contents of other objects yourself.
+// @within References
+void *obj_transfer(void *P) {
+    ObjHeader *h = obj_header_(P);
+    if (h->_alloc == OBJ_ALLOC_ARENA || obj_atomic_load_(&h->_owner) != thread_id())
+        return P;
+    if (_pool_cleaner)
+        _pool_cleaner(P);
+    int refs = h->_ref;
+    h->_ref = 0;
+    obj_atomic_store_(&h->_owner,0);
+    obj_atomic_add_(&h->_shared,2*refs + OBJ_MERGED);
+    if (h->is_array && h->is_ref_container) {
+        void **arr = (void**)P;
+        for (int i = 0, n = h->_len; i < n; i++) {
+            if (arr[i])
+                obj_transfer(arr[i]);
+        }
     }
+    return P;
+}
+
+/// make the calling thread the owner of an object.
+// This only succeeds if the object has no owner (see `obj_transfer`) and the
+// caller holds the only reference; its references are then cheap again.
+// @within References
+bool obj_adopt(void *P) {
+    ObjHeader *h = obj_header_(P);
+    if (h->_alloc == OBJ_ALLOC_ARENA)
+        return false;
+    if (obj_atomic_load_(&h->_owner) == thread_id())
+        return true;
+    // nobody else can take a reference while we hold the only one
+    if (! obj_atomic_cas_(&h->_shared,2 + OBJ_MERGED,0))
+        return false;
+    h->_ref = 1;
+    obj_atomic_store_(&h->_owner,thread_id());
+    return true;
+}
+
+static void shared_scope_dispose(int *p) {
+    --s_shared_scopes;
+}
+
+/// objects created by this thread will have no owner, until the result is disposed.
+// Such objects may be passed to other threads and released there without `obj_transfer`,
+// but every reference costs an atomic operation. `scoped_shared` creates objects
+// without owner until the end of the current block.
+// @within References
+void *obj_shared_scope() {
+    // the marker itself belongs to us
+    int *marker = obj_new(int,shared_scope_dispose);
+    ++s_shared_scopes;
+    return marker;
+}
+#endif
+
+// called by arena.c when the arena is released, for each object which has
+// a dispose function or is a reference array; the memory goes with the arena
+void obj_release_(void *P) {
+    ObjHeader *h = obj_header_(P);
+    // promoted objects are left behind as shells, owning nothing
+    if (h->_ref != 0)
+        obj_dispose_(h,P);
+}
+
+/// move an object out of the current arena.
+// Objects allocated while an arena is active die with the arena.
+// This makes a heap copy which takes over ownership of whatever the
+// original referred to; the original is left as an empty shell.
+// The elements of reference arrays are promoted as well, but you
+// must promote the fields of structs yourself.
+// @within References
+void *obj_promote(void *P) {
+    ObjHeader *h = obj_header_(P);
+    if (h->_alloc != OBJ_ALLOC_ARENA)
+        return P;
+    OTP t = obj_type_(h);
+    int size = obj_arena_size_(h) - sizeof(ObjHeader);
+    // the copy must not go into the arena!
+    void *(*arena_alloc)(int) = _arena_alloc;
+    _arena_alloc = NULL;
+    ObjHeader *nh = new_obj(size,t,-1);
+    _arena_alloc = arena_alloc;
+    int kind = nh->_alloc;
+    *nh = *h;
+    nh->_alloc = kind;
+    init_refs(nh);
+    void *NP = PTR_FROM_HEADER(nh);
+    memcpy(NP,P,size);
+    h->_ref = 0;
+    if (h->is_array && h->is_ref_container) {
+        void **arr = (void**)NP;
+        for (int i = 0, n = h->_len; i < n; i++) {
+            if (arr[i])
+                arr[i] = obj_promote(arr[i]);
+        }
+    }
+    return NP;
 }
 
 void obj_apply_v_varargs(void *o, PFun fn,va_list ap) {
@@ -555,46 +1223,70 @@ const char *dump_(void *P) {
     return str_new(buff);
 }
 
-#ifdef LLIB_PTR_LIST
-void obj_dump_ptrs() {
-    printf("+++ llib objects\n");
-    FOR(i,max_p) {
-        if (our_ptrs[i] != NULL) {
-            void *P = (void*)((ObjHeader*)our_ptrs[i] + 1);
-            puts(dump_(P));
+// copy out the live objects, so that we can allocate while looking at them
+static void **ptrs_copy(int *pn) {
+    int n = 0, cap = obj_kount() + 16;
+    void **res = (void**)malloc(sizeof(void*)*cap);
+    FOR(i,PTR_SHARDS) {
+        PtrSet *ps = &s_ptrs[i];
+        shard_lock(ps);
+        for (unsigned int k = 0; ps->ptrs && k <= ps->mask; k++) {
+            if (ps->ptrs[k].p && n < cap)
+                res[n++] = PTR_FROM_HEADER(ps->ptrs[k].p);
         }
+        shard_unlock(ps);
     }
+    int ns = obj_slab_live_(res+n,cap-n);
+    for (int i = n; i < n + ns; i++)
+        res[i] = PTR_FROM_HEADER(res[i]);
+    n += ns;
+    *pn = n;
+    return res;
+}
+
+static int compare_ptrs(const void *a, const void *b) {
+    uintptr_t pa = (uintptr_t)*(void**)a, pb = (uintptr_t)*(void**)b;
+    return pa < pb ? -1 : (pa > pb);
+}
+
+void obj_dump_pointers() {
+    int n;
+    void **ptrs = ptrs_copy(&n);
+    printf("+++ llib objects\n");
+    FOR(i,n)
+        puts(dump_(ptrs[i]));
     printf("+++\n");
+    free(ptrs);
 }
 
-static void **s_ptrs;
+static void **s_snap_ptrs;
+static int s_snap_n;
 
 void obj_snap_ptrs_create() {
-    if (s_ptrs)
-        free(s_ptrs);
-    s_ptrs = (void**)malloc(sizeof(void*)*MAX_PTRS);
-    FOR(i,MAX_PTRS)
-        s_ptrs[i] = our_ptrs[i];
+    if (s_snap_ptrs)
+        free(s_snap_ptrs);
+    s_snap_ptrs = ptrs_copy(&s_snap_n);
+    qsort(s_snap_ptrs,s_snap_n,sizeof(void*),compare_ptrs);
 }
 
 void obj_snap_ptrs_dump() {
-    if (! s_ptrs)
+    if (! s_snap_ptrs)
         return;
-    FOR(i,MAX_PTRS) {
-        if (our_ptrs[i] != NULL && s_ptrs[i] == NULL) {
-            void *P = (void*)((ObjHeader*)our_ptrs[i] + 1);
+    int n;
+    void **ptrs = ptrs_copy(&n);
+    FOR(i,n) {
+        void *P = ptrs[i];
+        if (! bsearch(&P,s_snap_ptrs,s_snap_n,sizeof(void*),compare_ptrs)) {
             const char *name = obj_typename(P);
             printf("%s %s\n",dump_(P),(strcmp(name,"char")==0 ? (char*)P : ""));
         }
     }
+    free(ptrs);
 }
-#endif
 
 void obj_dump_all() {
     obj_dump_types(false);
-#ifdef LLIB_PTR_LIST
-    obj_dump_ptrs();
-#endif
+    obj_dump_pointers();
 }
 
 void obj_free_set(bool set) {
@@ -606,34 +1298,36 @@ typedef unsigned char byte;
 
 //? allocates len+1 - ok?
 
-void *array_new_(int mlen, const char *name, int len, int isref) {
-    if (! initialized) {
-        initialize_types();
-    }
-
-    OTP t = type_from_dtor(name,NULL);
-    if (! t)
-        t = new_type(mlen,name,NULL);
-
-    ObjHeader *h = new_obj(mlen*(len+1),t);
+static void *array_from_type(OTP t, int mlen, int len, int isref) {
+    ObjHeader *h = new_obj(mlen*(len+1),t,len);
     byte *P;
     h->type = t->idx;
     h->_len = len;
-    h->_ref = 1;
+    init_refs(h);
     h->is_array = 1;
     h->is_ref_container = isref;
     P = (byte*)PTR_FROM_HEADER(h);
+    if (isref && h->_alloc == OBJ_ALLOC_ARENA)
+        obj_arena_keep_(P);
     if (isref) {  // ref arrays are fully zeroed out
         memset(P,0,mlen*(len+1));
     } else { // otherwise just the last element
         memset(P+mlen*len,0,mlen);
     }
 #ifdef LLIB_DEBUG_VERBOSE
-    fprintf(stderr,"arr %s %p[%d] %d\n",name,P,len,isref);
+    fprintf(stderr,"arr %s %p[%d] %d\n",t->name,P,len,isref);
 #endif
     return P;
 }
 
+void *array_new_(int mlen, const char *name, int len, int isref) {
+    return array_from_type(type_resolve(mlen,name,NULL),mlen,len,isref);
+}
+
+void *array_new_from_type_(int ti, int mlen, int len, int isref) {
+    return array_from_type(&obj_types[ti],mlen,len,isref);
+}
+
 /// new array from type.
 // @tparam T type name of type
 // @int sz size of array
@@ -687,16 +1381,72 @@ void * array_copy(void *P, int i1, int i2) {
     return newp;
 }
 
+// Resize an array which nobody else refers to, without copying it if we can:
+// an array in a slab slot stays put if it still fits, and an array from malloc
+// is passed to realloc. Returns NULL if the array has to be copied.
+static void *array_resize_in_place(ObjHeader *h, int newsz) {
+    OTP t = obj_type_(h);
+    int mlen = t->mlem, len = h->_len;
+    int size = sizeof(ObjHeader) + mlen*(newsz+1);
+#ifdef LLIB_DEBUG
+    if (! s_do_free)
+        return NULL;
+#endif
+    if (h->_alloc == OBJ_ALLOC_SLAB) {
+        if (size > obj_slab_size_(h))
+            return NULL;
+    } else if (h->_alloc == OBJ_ALLOC_HEAP && size > SLAB_MAX_SIZE) {
+        // (the old address is only used as a key from now on)
+        uintptr_t old = (uintptr_t)h;
+        int oldsize = remove_our_ptr(h);
+        h = (ObjHeader*)realloc(h,size);
+        add_our_ptr(h,size);
+        count_resize(h->type,oldsize,size);
+        if ((uintptr_t)h != old) {
+            if (obj_atomic_load_(&_obj_profile_samples))
+                obj_profile_move_(old,h);
+            if (_pool_mover)
+                _pool_mover(PTR_FROM_HEADER(old),PTR_FROM_HEADER(h));
+        }
+    } else {
+        return NULL;
+    }
+    // leave it in the same state as a new array
+    char *P = (char*)PTR_FROM_HEADER(h);
+    if (newsz > len && h->is_ref_container)
+        memset(P + mlen*len,0,mlen*(newsz-len+1));
+    else
+        memset(P + mlen*newsz,0,mlen);
+    h->_len = newsz;
+    return P;
+}
+
 /// resize an array.
+// If nothing else refers to the array, it is resized in place where possible;
+// otherwise the new array is a copy. Either way, the old array pointer must
+// not be used afterwards. If the old array goes, the elements of a reference array
+// which are cut off are released.
 // @param P the array
 // @param newsz the new size
 // @within Array
 void * array_resize(void *P, int newsz) {
     ObjHeader *pr = obj_header_(P);
     OTP t = obj_type_(pr);
-    int mlen = t->mlem;
+    int mlen = t->mlem, len = pr->_len;
+    if (sole_ref(pr)) {
+        if (pr->is_ref_container) {
+            void **arr = (void**)P;
+            for (int i = newsz; i < len; i++) {
+                obj_unref(arr[i]);
+                arr[i] = NULL;
+            }
+        }
+        void *newp = array_resize_in_place(pr,newsz);
+        if (newp)
+            return newp;
+    }
     void *newp = array_new_(mlen,t->name,newsz,pr->is_ref_container);
-    memcpy(newp,P,mlen*pr->_len);
+    memcpy(newp,P,mlen*(newsz < len ? newsz : len));
     // if old ref array is going to die, make sure it doesn't dispose our elements
     pr->is_ref_container = 0;
     obj_unref(P);
@@ -709,9 +1459,15 @@ void * array_resize(void *P, int newsz) {
 /// create a refcounted string copy.
 // @within New
 char *str_new(const char *s) {
-    int sz = strlen(s);
-    char *ns = str_new_size(sz);
-    memcpy(ns,s,sz);
+    return str_new_len(s,strlen(s));
+}
+
+/// make a refcounted string from the first `len` bytes of `s`.
+// These need not be text, since the result knows its length.
+// @within New
+char *str_new_len(const char *s, int len) {
+    char *ns = str_new_size(len);
+    memcpy(ns,s,len);
     return ns;
 }
 
@@ -745,6 +1501,100 @@ char *str_cpy(const char *s) {
     }
 }
 
+/// hash of a string.
+// This is FNV-1a; the intern table keeps it for each string.
+// @within New
+unsigned int str_hash(const char *s) {
+    unsigned int h = 2166136261u;
+    for (; *s; s++)
+        h = (h ^ (unsigned char)*s) * 16777619u;
+    return h;
+}
+
+// The intern table holds the canonical copy of each string with its hash,
+// using linear probing; it is never more than half full.
+typedef struct InternSlot_ {
+    unsigned int hash;
+    char *s;
+} InternSlot;
+
+static InternSlot *s_interned;
+static unsigned int s_intern_mask, s_intern_count;
+
+static InternSlot *intern_slot(const char *s, unsigned int h) {
+    for (unsigned int i = h; ; i++) {
+        InternSlot *slot = &s_interned[i & s_intern_mask];
+        if (! slot->s || slot->s == s || (slot->hash == h && strcmp(slot->s,s) == 0))
+            return slot;
+    }
+}
+
+static void intern_grow() {
+    InternSlot *old = s_interned;
+    unsigned int n = old ? s_intern_mask + 1 : 0;
+    unsigned int nslots = old ? 2*n : 256;
+    s_interned = (InternSlot*)calloc(nslots,sizeof(InternSlot));
+    s_intern_mask = nslots - 1;
+    for (unsigned int i = 0; i < n; i++) {
+        if (old[i].s)
+            *intern_slot(old[i].s,old[i].hash) = old[i];
+    }
+    free(old);
+}
+
+/// the canonical refcounted copy of a string.
+// Equal strings always give the same pointer, so interned strings can be
+// compared with `==`; maps and lists made with `LIST_INTERN` intern their keys
+// and compare pointers before strings. The caller gets a new reference.
+// The table keeps one too, so an interned string lives at least until `str_intern_clear`,
+// even if it was first interned inside an arena or pool.
+// @within New
+char *str_intern(const char *s) {
+    unsigned int h = str_hash(s);
+    lock_intern();
+    if (! s_interned || 2*(s_intern_count + 1) > s_intern_mask + 1)
+        intern_grow();
+    InternSlot *slot = intern_slot(s,h);
+    if (! slot->s) {
+        // the table outlives any arena or pool, so the copy must not go into them.
+        // Any thread may clear the table, so the copy has no owner
+        void *(*arena_alloc)(int) = _arena_alloc;
+        DisposeFn pool_filter = _pool_filter;
+        _arena_alloc = NULL;
+        _pool_filter = NULL;
+#ifdef LLIB_THREADS
+        ++s_shared_scopes;
+#endif
+        slot->hash = h;
+        slot->s = str_new(s);
+#ifdef LLIB_THREADS
+        --s_shared_scopes;
+#endif
+        _arena_alloc = arena_alloc;
+        _pool_filter = pool_filter;
+        ++s_intern_count;
+    }
+    char *res = slot->s;
+    obj_incr_(res);
+    unlock_intern();
+    return res;
+}
+
+/// release the intern table's references.
+// Interned strings still in use are not affected, but are no longer canonical.
+// @within New
+void str_intern_clear() {
+    lock_intern();
+    for (unsigned int i = 0; s_interned && i <= s_intern_mask; i++) {
+        if (s_interned[i].s)
+            obj_unref(s_interned[i].s);
+    }
+    free(s_interned);
+    s_interned = NULL;
+    s_intern_mask = s_intern_count = 0;
+    unlock_intern();
+}
+
 /// sort an array.
 // @tparam T* P the array
 // @int kind  either `ARRAY_INT` or `ARRAY_STR`
@@ -866,12 +1716,32 @@ int seq_decr_len(void *sp) {
 // @int sz number of values (-1 means use `array_len`)
 // @function seq_adda
 
+/// append `n` values to a sequence.
+// There is only one check for capacity. As with `seq_add`, a reference
+// sequence takes over the references. If `items` is `NULL`, the new values are zeroed.
+// Returns the index of the first new value.
+// @param s the sequence
+// @param items pointer to the values
+// @int n number of values
+// @function seq_add_n
+
+/// make room for at least `n` values.
+// The length does not change, but up to `n` values can then be added
+// without any more allocation.
+// @param s the sequence
+// @int n number of values
+// @function seq_reserve
+
+/// release any spare capacity of a sequence.
+// @param s the sequence
+// @function seq_shrink_to_fit
+
 int seq_next_(void *sp) {
     Seq *s = (Seq *)sp;
     void *a = s->arr;
     int len = array_len(a);
     if (len == s->cap) {
-        s->cap *= GROW_CAP;
+        s->cap = s->cap ? s->cap*GROW_CAP : INITIAL_CAP;
         s->arr = array_resize(s->arr, s->cap);
     }
     // the idea is that the seq's array has _always_ got the correct length
@@ -22,15 +22,60 @@ typedef struct ObjAllocator_ {
     void *data;
 } ObjAllocator;
 
-// 64-bit header
+// 64-bit header. With LLIB_THREADS, references are _biased_ towards the
+// thread which created the object: the owner updates `_ref` without atomic
+// operations, and other threads use the atomic `_shared` count.
 typedef struct ObjHeader_ {
-    unsigned int type:14;
-    unsigned int is_array:1;
-    unsigned int is_ref_container:1;
-    unsigned int _ref:16;
-    unsigned int _len:32;
+#ifdef LLIB_THREADS
+    unsigned int _owner;   // owning thread, or zero if none
+    int _shared;           // shared references (times two), plus OBJ_MERGED
+#endif
+    unsigned short type:12;
+    unsigned short is_array:1;
+    unsigned short is_ref_container:1;
+    unsigned short _alloc:2;
+    unsigned short _ref;
+    unsigned int _len;
 } ObjHeader;
 
+// set in _shared when the owner gives up its references
+#define OBJ_MERGED 1
+
+// With LLIB_THREADS, some counts are updated atomically, and pools and
+// arenas (and their hooks) are per-thread. obj_atomic_add_ returns the new value;
+// obj_atomic_or_ returns the old value, but only with LLIB_THREADS.
+#ifdef LLIB_THREADS
+#ifdef _MSC_VER
+#include <intrin.h>
+#define LLIB_TLS __declspec(thread)
+#define obj_atomic_add_(p,n) (_InterlockedExchangeAdd((long*)(p),n) + (n))
+#define obj_atomic_or_(p,v) _InterlockedOr((long*)(p),v)
+#define obj_atomic_and_(p,v) _InterlockedAnd((long*)(p),v)
+#define obj_atomic_cas_(p,o,v) (_InterlockedCompareExchange((long*)(p),v,o) == (o))
+#define obj_atomic_cas_ptr_(p,o,v) (_InterlockedCompareExchangePointer((void*volatile*)(p),v,o) == (o))
+// aligned loads and stores are atomic on x86 and x64
+#define obj_atomic_load_(p) (_ReadWriteBarrier(), *(p))
+#define obj_atomic_store_(p,v) (_ReadWriteBarrier(), *(p) = (v))
+#else
+#define LLIB_TLS __thread
+#define obj_atomic_add_(p,n) __atomic_add_fetch(p,n,__ATOMIC_ACQ_REL)
+#define obj_atomic_or_(p,v) __atomic_fetch_or(p,v,__ATOMIC_ACQ_REL)
+#define obj_atomic_and_(p,v) __atomic_fetch_and(p,v,__ATOMIC_ACQ_REL)
+#define obj_atomic_cas_(p,o,v) __sync_bool_compare_and_swap(p,o,v)
+#define obj_atomic_cas_ptr_(p,o,v) __sync_bool_compare_and_swap(p,o,v)
+#define obj_atomic_load_(p) __atomic_load_n(p,__ATOMIC_ACQUIRE)
+#define obj_atomic_store_(p,v) __atomic_store_n(p,v,__ATOMIC_RELEASE)
+#endif
+#else
+#define LLIB_TLS
+#define obj_atomic_add_(p,n) (*(p) += (n))
+#define obj_atomic_or_(p,v) (*(p) |= (v))
+#define obj_atomic_and_(p,v) (*(p) &= (v))
+#define obj_atomic_cas_ptr_(p,o,v) (*(p) == (o) && (*(p) = (v), 1))
+#define obj_atomic_load_(p) (*(p))
+#define obj_atomic_store_(p,v) (*(p) = (v))
+#endif
+
 // predefined base types
 enum {
     OBJ_CHAR_T = 0,
@@ -43,6 +88,14 @@ enum {
     OBJ_KEYVALUE_T = 7
 };
 
+// how an object was allocated (the _alloc field)
+enum {
+    OBJ_ALLOC_HEAP = 0,
+    OBJ_ALLOC_SLAB = 1,
+    OBJ_ALLOC_CUSTOM = 2,
+    OBJ_ALLOC_ARENA = 3
+};
+
 // this is type 7
 typedef struct {
     void *key;
@@ -94,14 +147,25 @@ ObjType* obj_type_from_index(int t);
 #define obj_type_index(P) (obj_header_(P)->type)
 #define obj_cast(T,P) (obj_is_instance(P,#T) ? (T*)P : NULL)
 
-#define obj_new(T,dtor) (T*)obj_new_(sizeof(T),#T,(DisposeFn)dtor)
 #define obj_new_type(T,dtor) obj_new_type_(sizeof(T),#T,(DisposeFn)dtor)
 #define obj_typeof(T) obj_typeof_(#T)
 #define obj_lookup_interface(T,P) (T*)obj_lookup_interface_(#T,P)
 #define obj_ref(P) (obj_incr_(P), P)
 #define obj_unref_v(...) obj_apply_varargs(NULL,(PFun)obj_unref,__VA_ARGS__,NULL)
+
+// Where the compiler allows, each use of these macros looks up its type once
+// and caches the type index in a static variable.
+#if defined(__GNUC__) && ! defined(LLIB_NO_TYPE_CACHE)
+#define obj_type_cached_(size,name,dtor) ({ static int t_ = -1; int i_ = obj_atomic_load_(&t_); \
+  i_ >= 0 ? i_ : (obj_atomic_store_(&t_,i_ = obj_type_resolve_(size,name,(DisposeFn)dtor)), i_); })
+#define obj_new(T,dtor) ((T*)obj_new_from_type(obj_type_cached_(sizeof(T),#T,dtor)))
+#define array_new(T,sz) ((T*)array_new_from_type_(obj_type_cached_(sizeof(T),#T,0),sizeof(T),sz,0))
+#define array_new_ref(T,sz) ((T*)array_new_from_type_(obj_type_cached_(sizeof(T),#T,0),sizeof(T),sz,1))
+#else
+#define obj_new(T,dtor) (T*)obj_new_(sizeof(T),#T,(DisposeFn)dtor)
 #define array_new(T,sz) (T*)array_new_(sizeof(T),#T,sz,0)
 #define array_new_ref(T,sz) (T*)array_new_(sizeof(T),#T,sz,1)
+#endif
 #define array_new_copy(T,buff,sz) (T*)array_new_copy_(sizeof(T),#T,sz,0,buff)
 
 #define FOR(i,n) for (int i = 0, n_ = (n); i < n_; i++)
@@ -114,8 +178,12 @@ ObjType* obj_type_from_index(int t);
 
 #ifdef __cplusplus
 #define obj_scoped_pool ObjUnref P_ = obj_pool()
+#define obj_scoped_arena ObjUnref A_ = obj_arena(0)
+#define obj_scoped_shared ObjUnref S_ = obj_shared_scope()
 #else
 #define obj_scoped_pool scoped void *P_ = obj_pool()
+#define obj_scoped_arena scoped void *A_ = obj_arena(0)
+#define obj_scoped_shared scoped void *S_ = obj_shared_scope()
 #endif
 
 #ifndef LLIB_NO_REF_ABBREV
@@ -124,19 +192,17 @@ ObjType* obj_type_from_index(int t);
 #define dispose obj_unref_v
 #define scoped obj_scoped
 #define scoped_pool obj_scoped_pool
+#define scoped_arena obj_scoped_arena
+#define scoped_shared obj_scoped_shared
 #endif
 
-#define obj_pool_count(P) (array_len(**((void****)P) ))
-
 #ifdef LLIB_DEBUG
 void obj_dump_types(bool all);
 const char *obj_type_name(void *P);
 const char *dump_(void *P);
-#ifdef LLIB_PTR_LIST
 void obj_dump_pointers();
 void obj_snap_ptrs_create();
 void obj_snap_ptrs_dump();
-#endif
 void obj_dump_all();
 void obj_free_set(bool set);
 void obj_snapshot_dump();
@@ -144,15 +210,28 @@ void obj_snapshot_create();
 #endif
 
 int obj_kount();
+#ifdef LLIB_THREADS
+void *obj_transfer(void *P);
+bool obj_adopt(void *P);
+void *obj_shared_scope();
+#endif
 void *obj_pool();
+int obj_pool_count(void *P);
+void *obj_arena(int chunk_size);
+void *obj_promote(void *P);
 int obj_new_type_(int size, const char *type, DisposeFn dtor);
 const char *obj_typename(const void *p);
 int obj_elem_size(const void *P);
 void *obj_new_from_type(int ti);
 void *obj_new_(int size, const char *type,DisposeFn dtor);
+int obj_type_resolve_(int size, const char *type, DisposeFn dtor);
 bool obj_is_instance(const void *P, const char *name);
 void obj_incr_(const void *P);
+typedef void (*ObjAttachFn)(void **pextra, void *arg);
+bool obj_attachment_(const void *P, ObjAttachFn fn, void *arg);
 void obj_unref(const void *P);
+void obj_defer_free(bool on);
+int obj_collect(int budget);
 void obj_apply_varargs(void *o, PFun fn,...);
 void __auto_unref(void *p) ;
 
@@ -169,13 +248,62 @@ void obj_apply_ (void *dest, PFun setter, void *src, PFun getter);
 int obj_refcount (const void *P);
 
 void *array_new_(int mlen, const char *name, int len, int ref);
+void *array_new_from_type_(int ti, int mlen, int len, int ref);
 void *array_new_copy_ (int mlen, const char *name, int len, int ref, void *P);
 void *array_copy(void *P, int i1, int i2);
 void *array_resize(void *P, int newsz);
 char *str_new(const char *s);
+char *str_new_len(const char *s, int len);
 char *str_new_size(int sz);
 const char *str_ref(const char *s);
 char *str_cpy(const char *s);
+unsigned int str_hash(const char *s);
+char *str_intern(const char *s);
+void str_intern_clear();
+
+// the small-object allocator
+#define SLAB_CLASSES 16
+#define SLAB_MAX_SIZE 512
+#define SLAB_CHUNK 65536
+
+typedef struct SlabStats_ {
+    int size;
+    int chunks;
+    int used;
+    int capacity;
+} SlabStats;
+
+void obj_slab_enable(bool on);
+SlabStats *obj_slab_stats();
+void obj_slab_dump();
+
+// allocation statistics, which are always kept for each type.
+// Array lengths are counted in powers of two: 0, 1, 2-3, 4-7, ...
+#define OBJ_LEN_BUCKETS 24
+
+typedef struct ObjTypeStats_ {
+    const char *name;
+    int type;
+    long long live;
+    long long allocs;
+    long long bytes;
+    long long peak;
+    long long lengths[OBJ_LEN_BUCKETS];
+} ObjTypeStats;
+
+ObjTypeStats *obj_type_stats(bool all);
+
+// the sampling allocation profiler
+typedef enum {
+    OBJ_PROFILE_LIVE,
+    OBJ_PROFILE_ALLOCATED,
+    OBJ_PROFILE_FREED
+} ObjProfileKind;
+
+void obj_profile_start(int interval);
+void obj_profile_stop();
+void obj_profile_reset();
+char *obj_profile_report(ObjProfileKind what);
 
 typedef enum {
     ARRAY_INT = 0,
@@ -214,6 +342,9 @@ void seq_resize(Seq *s, int nsz);
 void seq_remove(void *sp, int pos, int len);
 void seq_insert(void *sp, int pos, void *src, int sz);
 void seq_adda(void *sp, void *buff, int sz);
+void seq_reserve(void *sp, int n);
+void seq_shrink_to_fit(void *sp);
+int seq_add_n(void *sp, const void *items, int n);
 void *seq_array_ref(void *sp);
 
 #endif
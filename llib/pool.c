@@ -8,92 +8,195 @@
 #include <stdio.h>
 
 ////// Object Pool Support //////
-// An object pool is a ref seq containing all objects generated since the pool
-// was created.  The actual pool object is a ref to that seq, so that disposing
+// An object pool is an array containing all objects generated since the pool
+// was created.  The actual pool object refers to that array, so that disposing
 // of it will drain the pool.
 //
 // As objects are explicitly unref'd, they're taken out of the pool by setting
 // their entry to NULL.  So when we finally drain the pool, it only contains
 // genuine alive orphan objects.
 //
+// To find an object's entry quickly, we keep a hash table mapping each pooled
+// object to its pool and slot. There is one table for all pools, so an object
+// may be taken out of an enclosing pool while a nested pool is active.
+//
+// With LLIB_THREADS, each thread has its own stack of pools.
 //
 
-extern DisposeFn _pool_filter, _pool_cleaner;
+extern LLIB_TLS DisposeFn _pool_filter, _pool_cleaner;
+extern LLIB_TLS void (*_pool_mover)(void *P, void *NP);
 
-typedef void* ObjPool;
+typedef struct Pool_ Pool;
 
-typedef void*** VoidSeq;
+struct Pool_ {
+    void **objs;
+    int n;      // number of slots used
+    int cap;
+    int live;   // number of objects still in the pool
+    Pool *prev; // enclosing pool, if any
+};
 
-static VoidSeq _obj_pool;
-static VoidSeq _pool_stack;
-static ObjPool *_pool_marker;
+typedef Pool* ObjPool;
 
-static void seq_stack_push(VoidSeq stack, void *value) {
-    seq_add(_pool_stack,_obj_pool);
-}
+static LLIB_TLS Pool *_obj_pool;
+
+typedef struct PoolSlot_ {
+    void *obj;
+    Pool *pool;
+    int slot;
+} PoolSlot;
+
+static LLIB_TLS PoolSlot *_slots;
+static LLIB_TLS unsigned int _slots_mask, _slots_count;
 
-static void *seq_stack_pop(VoidSeq stack) {
-    void **arr = *stack;
-    int top = array_len(arr)-1;
-    if (top == -1) // empty?
+#define hash_ptr(P) ((unsigned int)((uintptr_t)(P) >> 4) * 2654435761u)
+
+static PoolSlot *slot_find(void *P) {
+    if (! _slots)
         return NULL;
-    void *val = arr[top];
-    array_len(arr) = top;
-    return val;
+    for (unsigned int i = hash_ptr(P); ; ++i) {
+        PoolSlot *ps = &_slots[i & _slots_mask];
+        if (ps->obj == P)
+            return ps;
+        if (ps->obj == NULL)
+            return NULL;
+    }
+}
+
+static void slot_insert(void *P, Pool *pool, int slot);
+
+static void slots_grow() {
+    PoolSlot *old = _slots;
+    unsigned int oldn = old ? _slots_mask + 1 : 0;
+    unsigned int n = old ? 2*oldn : 64;
+    _slots = (PoolSlot*)calloc(n,sizeof(PoolSlot));
+    _slots_mask = n - 1;
+    _slots_count = 0;
+    for (unsigned int i = 0; i < oldn; i++) {
+        if (old[i].obj)
+            slot_insert(old[i].obj,old[i].pool,old[i].slot);
+    }
+    free(old);
+}
+
+static void slot_insert(void *P, Pool *pool, int slot) {
+    if (! _slots || 2*(_slots_count + 1) > _slots_mask + 1)
+        slots_grow();
+    unsigned int i = hash_ptr(P);
+    while (_slots[i & _slots_mask].obj)
+        ++i;
+    PoolSlot *ps = &_slots[i & _slots_mask];
+    ps->obj = P;
+    ps->pool = pool;
+    ps->slot = slot;
+    ++_slots_count;
+}
+
+// linear probing lets us delete without tombstones, by shifting any
+// following entries of the probe run back into the hole.
+static void slot_remove(PoolSlot *ps) {
+    unsigned int hole = ps - _slots, i = hole;
+    --_slots_count;
+    for (;;) {
+        i = (i + 1) & _slots_mask;
+        void *P = _slots[i].obj;
+        if (P == NULL)
+            break;
+        unsigned int home = hash_ptr(P) & _slots_mask;
+        // can this entry move back into the hole?
+        if (((i - home) & _slots_mask) >= ((i - hole) & _slots_mask)) {
+            _slots[hole] = _slots[i];
+            hole = i;
+        }
+    }
+    _slots[hole].obj = NULL;
 }
 
 static void pool_add(void *P) {
-    seq_add(_obj_pool, P);
+    Pool *pool = _obj_pool;
+    if (pool->n == pool->cap) {
+        pool->cap = pool->cap ? 2*pool->cap : 16;
+        pool->objs = (void**)realloc(pool->objs,pool->cap*sizeof(void*));
+    }
+    pool->objs[pool->n] = P;
+    slot_insert(P,pool,pool->n);
+    ++pool->n;
+    ++pool->live;
 }
 
 static void pool_clean(void *P) {
-    void **objs = *_obj_pool;
-    FOR(i,array_len(objs)) {
-        if (objs[i] == P) {
-#ifdef LLIB_DEBUG_VERBOSE        
-            fprintf(stderr,"clean %p\n",P);
+    PoolSlot *ps = slot_find(P);
+    if (ps) {
+#ifdef LLIB_DEBUG_VERBOSE
+        fprintf(stderr,"clean %p\n",P);
 #endif
-            objs[i] = NULL;
-            break;
-        }
+        ps->pool->objs[ps->slot] = NULL;
+        --ps->pool->live;
+        slot_remove(ps);
     }
 }
 
-static void pool_dispose(ObjPool * p) {
-    // NB not to try any cleanup at this point!
-    _pool_cleaner = NULL;
-    obj_unref(*p);  // kill the actual pool (ref seq containing objects)
-    _pool_cleaner = pool_clean;
+// an array resized in place may have moved
+static void pool_move(void *P, void *NP) {
+    PoolSlot *ps = slot_find(P);
+    if (ps) {
+        Pool *pool = ps->pool;
+        int slot = ps->slot;
+        slot_remove(ps);
+        pool->objs[slot] = NP;
+        slot_insert(NP,pool,slot);
+    }
+}
+
+static void pool_dispose(ObjPool *p) {
+    Pool *pool = *p;
+    // The cleaner stays active while draining, since disposing an orphan may well
+    // dispose other objects in the pool. Any objects created by dispose functions
+    // are added to the end of this pool, and drained as well.
+    for (int i = 0; i < pool->n; i++) {
+        void *P = pool->objs[i];
+        if (P) {
+            pool_clean(P);
+            obj_unref(P);
+        }
+    }
 
-    _obj_pool = (VoidSeq)seq_stack_pop(_pool_stack);
+    _obj_pool = pool->prev;
+    free(pool->objs);
+    free(pool);
 
     if (_obj_pool == NULL) { // stop using the pool; it's dead!
-        _pool_marker = NULL;
         _pool_filter = NULL;
         _pool_cleaner = NULL;
-        obj_unref(_pool_stack);
-        _pool_stack = NULL;
+        _pool_mover = NULL;
+        free(_slots);
+        _slots = NULL;
     }
 }
 
 /// create an object pool which will collect all references generated by llib
 void *obj_pool() {
-    if (! _pool_stack) {
-        _pool_stack = seq_new(void*);
-    }
+    Pool *pool = (Pool*)calloc(1,sizeof(Pool));
     _pool_cleaner = NULL;
     _pool_filter = NULL;
-    // push  the current pool on the stack (will always be NULL initially)
-    seq_stack_push(_pool_stack,_obj_pool);
-    _obj_pool = seq_new_ref(void*);
+    _pool_mover = NULL;
     // the new pool is referenced by this object which controls
     // the pool's lifetime
-    _pool_marker = obj_new(ObjPool,pool_dispose);
-    *_pool_marker = _obj_pool;
+    ObjPool *marker = obj_new(ObjPool,pool_dispose);
+    *marker = pool;
+    // push the current pool on the stack (will always be NULL initially)
+    pool->prev = _obj_pool;
+    _obj_pool = pool;
     // the core will access the pool through these function pointers
     _pool_filter = pool_add;
     _pool_cleaner = pool_clean;
-    return (void*)_pool_marker;
+    _pool_mover = pool_move;
+    return (void*)marker;
+}
+
+/// number of objects still owned by a pool.
+int obj_pool_count(void *P) {
+    return (*(ObjPool*)P)->live;
 }
 
 // this is a helper for the magic 'scoped' macro
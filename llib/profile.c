@@ -0,0 +1,355 @@
+/*
+* llib little C library
+* BSD licence
+* Copyright Steve Donovan, 2013
+*/
+
+/***
+### Sampling Allocation Profiler.
+
+Once `obj_profile_start` is called, roughly one in every N bytes allocated
+as llib objects is sampled: the backtrace of the allocation is recorded, and
+the sample stands for N bytes allocated at that _site_. When a sampled object
+is freed, its bytes move from live to freed.  `obj_profile_report` gives the
+result in the 'folded stack' format understood by `flamegraph.pl`, speedscope
+and `pprof`-style tools: one line per site, with the frames from the outermost
+inwards separated by semicolons, the type name in brackets, and then the bytes.
+
+    obj_profile_start(512*1024);
+    ...
+    char *prof = obj_profile_report(OBJ_PROFILE_LIVE);
+    fputs(prof,out);
+
+Function names come from the dynamic symbol table, so link with `-rdynamic`
+to see the names of functions in the executable; otherwise frames are
+shown as addresses. Backtraces are available with glibc and on Windows.
+
+The gaps between samples are random, so that regular allocation patterns
+do not fool the profiler. A sample interval of 1 records every allocation
+at its true size. When sampling is off, the cost is one test per allocation,
+and one per free while any sampled objects are still alive.
+
+@module profile
+*/
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200112L
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "obj.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#define get_backtrace(frames,n) CaptureStackBackTrace(0,n,frames,NULL)
+#elif defined(__GLIBC__)
+#include <execinfo.h>
+#define get_backtrace(frames,n) backtrace(frames,n)
+#define HAS_SYMBOLS
+#else
+#define get_backtrace(frames,n) 0
+#endif
+
+#ifdef LLIB_THREADS
+#ifdef _WIN32
+static SRWLOCK s_profile_lock = SRWLOCK_INIT;
+#define lock_profile() AcquireSRWLockExclusive(&s_profile_lock)
+#define unlock_profile() ReleaseSRWLockExclusive(&s_profile_lock)
+#else
+#include <pthread.h>
+static pthread_mutex_t s_profile_lock = PTHREAD_MUTEX_INITIALIZER;
+#define lock_profile() pthread_mutex_lock(&s_profile_lock)
+#define unlock_profile() pthread_mutex_unlock(&s_profile_lock)
+#endif
+#else
+#define lock_profile()
+#define unlock_profile()
+#endif
+
+// shared with obj.c
+int _obj_profiling, _obj_profile_samples;
+
+#define MAX_DEPTH 32
+#define SITE_HASH 1024
+
+typedef struct Site_ Site;
+
+struct Site_ {
+    Site *next;
+    unsigned int hash;
+    const char *type;
+    int depth;
+    void *frames[MAX_DEPTH];
+    long long allocated, live, freed;
+};
+
+// a sampled object, and the bytes it stands for
+typedef struct Sample_ {
+    void *obj;
+    Site *site;
+    long long bytes;
+} Sample;
+
+static Site *s_sites[SITE_HASH];
+static int s_interval;
+
+// sampled objects, in an open-addressed table
+static Sample *s_samples;
+static unsigned int s_samples_mask;
+
+static LLIB_TLS long long s_until;
+static LLIB_TLS unsigned int s_random = 2463534242u;
+
+#define hash_obj(p) ((unsigned int)((uintptr_t)(p) >> 4) * 2654435761u)
+
+// the gap to the next sample is uniform in [1,2N-1], so N on average
+static int next_gap(int interval) {
+    unsigned int x = s_random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    s_random = x;
+    return 1 + x % (2*interval - 1);
+}
+
+static Site *find_site(void **frames, int depth, const char *type) {
+    unsigned int h = 2166136261u ^ hash_obj(type);
+    FOR(i,depth)
+        h = (h ^ hash_obj(frames[i])) * 16777619u;
+    Site **ps = &s_sites[h % SITE_HASH];
+    for (Site *s = *ps; s; s = s->next) {
+        if (s->hash == h && s->type == type && s->depth == depth &&
+                memcmp(s->frames,frames,depth*sizeof(void*)) == 0)
+            return s;
+    }
+    Site *s = (Site*)calloc(1,sizeof(Site));
+    s->hash = h;
+    s->type = type;
+    s->depth = depth;
+    memcpy(s->frames,frames,depth*sizeof(void*));
+    s->next = *ps;
+    *ps = s;
+    return s;
+}
+
+static void add_sample(Sample *smp);
+
+static void grow_samples() {
+    Sample *old = s_samples;
+    unsigned int oldn = old ? s_samples_mask + 1 : 0;
+    unsigned int n = old ? 2*oldn : 256;
+    s_samples = (Sample*)calloc(n,sizeof(Sample));
+    s_samples_mask = n - 1;
+    for (unsigned int i = 0; i < oldn; i++) {
+        if (old[i].obj)
+            add_sample(&old[i]);
+    }
+    free(old);
+}
+
+static void add_sample(Sample *smp) {
+    unsigned int i = hash_obj(smp->obj);
+    while (s_samples[i & s_samples_mask].obj)
+        ++i;
+    s_samples[i & s_samples_mask] = *smp;
+}
+
+// as with the set of live objects in obj.c, entries following the hole
+// are shifted back so that no tombstones are needed
+static bool remove_sample(void *obj, Sample *smp) {
+    unsigned int hole = hash_obj(obj);
+    for (;; ++hole) {
+        void *q = s_samples[hole & s_samples_mask].obj;
+        if (q == obj)
+            break;
+        if (q == NULL)
+            return false;
+    }
+    hole &= s_samples_mask;
+    *smp = s_samples[hole];
+    for (unsigned int i = hole;;) {
+        i = (i + 1) & s_samples_mask;
+        void *q = s_samples[i].obj;
+        if (q == NULL)
+            break;
+        unsigned int home = hash_obj(q) & s_samples_mask;
+        if (((i - home) & s_samples_mask) >= ((i - hole) & s_samples_mask)) {
+            s_samples[hole] = s_samples[i];
+            hole = i;
+        }
+    }
+    s_samples[hole].obj = NULL;
+    return true;
+}
+
+// called by `new_obj` while sampling is on, with the object header
+void obj_profile_alloc_(void *obj, const char *type, int size) {
+    s_until -= size;
+    if (s_until > 0)
+        return;
+    int interval = obj_atomic_load_(&s_interval);
+    if (interval <= 0)
+        return;
+    long long bytes = 0;
+    if (interval == 1) { // every allocation, at its size
+        bytes = size;
+        s_until = 1;
+    } else {
+        // a big object may stand for more than one sample
+        while (s_until <= 0) {
+            s_until += next_gap(interval);
+            bytes += interval;
+        }
+    }
+    void *frames[MAX_DEPTH+1];
+    int depth = get_backtrace(frames,MAX_DEPTH+1) - 1; // not this function!
+    if (depth < 0)
+        depth = 0;
+    lock_profile();
+    Sample smp;
+    smp.obj = obj;
+    smp.site = find_site(frames+1,depth,type);
+    smp.bytes = bytes;
+    smp.site->allocated += bytes;
+    smp.site->live += bytes;
+    if (! s_samples || 2*(_obj_profile_samples + 1) > s_samples_mask + 1)
+        grow_samples();
+    add_sample(&smp);
+    obj_atomic_store_(&_obj_profile_samples,_obj_profile_samples + 1);
+    unlock_profile();
+}
+
+// called by `obj_free_` while there are sampled objects
+void obj_profile_free_(void *obj) {
+    Sample smp;
+    lock_profile();
+    if (s_samples && remove_sample(obj,&smp)) {
+        smp.site->live -= smp.bytes;
+        smp.site->freed += smp.bytes;
+        obj_atomic_store_(&_obj_profile_samples,_obj_profile_samples - 1);
+    }
+    unlock_profile();
+}
+
+// called when an object may have been sampled before `realloc` moved it
+void obj_profile_move_(uintptr_t obj, void *nobj) {
+    Sample smp;
+    lock_profile();
+    if (s_samples && remove_sample((void*)obj,&smp)) {
+        smp.obj = nobj;
+        add_sample(&smp);
+    }
+    unlock_profile();
+}
+
+/// start sampling allocations.
+// On average, one sample is taken for every `interval` bytes allocated; an interval
+// of 1 records every allocation. Sites already recorded are kept.
+// @int interval bytes between samples
+// @within Profiling
+void obj_profile_start(int interval) {
+    obj_atomic_store_(&s_interval,interval > 0 ? interval : 1);
+    obj_atomic_store_(&_obj_profiling,1);
+}
+
+/// stop sampling allocations.
+// Sampled objects which are still alive are still followed, so that the
+// report can show when they are freed.
+// @within Profiling
+void obj_profile_stop() {
+    obj_atomic_store_(&_obj_profiling,0);
+}
+
+/// forget all sites and samples.
+// @within Profiling
+void obj_profile_reset() {
+    lock_profile();
+    FOR(i,SITE_HASH) {
+        Site *next;
+        for (Site *s = s_sites[i]; s; s = next) {
+            next = s->next;
+            free(s);
+        }
+        s_sites[i] = NULL;
+    }
+    free(s_samples);
+    s_samples = NULL;
+    obj_atomic_store_(&_obj_profile_samples,0);
+    unlock_profile();
+}
+
+typedef struct Buff_ {
+    char *s;
+    int len, cap;
+} Buff;
+
+static void buff_add(Buff *b, const char *s, int n) {
+    if (b->len + n + 1 > b->cap) {
+        b->cap = 2*(b->len + n + 1);
+        b->s = (char*)realloc(b->s,b->cap);
+    }
+    memcpy(b->s + b->len,s,n);
+    b->len += n;
+    b->s[b->len] = '\0';
+}
+
+// glibc gives us 'file(name+offset) [address]'
+static void add_frame(Buff *b, void *frame, char *sym) {
+    char buff[32];
+    if (sym) {
+        char *name = strchr(sym,'('), *end = name ? strpbrk(name,"+)") : NULL;
+        if (end && end > name + 1) {
+            buff_add(b,name+1,end-name-1);
+            return;
+        }
+    }
+    snprintf(buff,sizeof(buff),"%p",frame);
+    buff_add(b,buff,strlen(buff));
+}
+
+/// the profile in folded-stack format.
+// Each line is a site, with its frames from the outermost inwards
+// and the type of object allocated, followed by the number of bytes.
+// @param what one of `OBJ_PROFILE_LIVE`, `OBJ_PROFILE_ALLOCATED` or `OBJ_PROFILE_FREED`
+// @treturn string
+// @within Profiling
+char *obj_profile_report(ObjProfileKind what) {
+    Buff b = {NULL,0,0};
+    char buff[64];
+    buff_add(&b,"",0);
+    lock_profile();
+    FOR(i,SITE_HASH) {
+        for (Site *s = s_sites[i]; s; s = s->next) {
+            long long bytes = what == OBJ_PROFILE_LIVE ? s->live :
+                (what == OBJ_PROFILE_FREED ? s->freed : s->allocated);
+            if (bytes == 0)
+                continue;
+            char **syms = NULL;
+#ifdef HAS_SYMBOLS
+            syms = backtrace_symbols(s->frames,s->depth);
+#endif
+            for (int k = s->depth - 1; k >= 0; k--) {
+                add_frame(&b,s->frames[k],syms ? syms[k] : NULL);
+                buff_add(&b,";",1);
+            }
+            free(syms);
+            buff_add(&b,"[",1);
+            buff_add(&b,s->type,strlen(s->type));
+            snprintf(buff,sizeof(buff),"] %lld\n",bytes);
+            buff_add(&b,buff,strlen(buff));
+        }
+    }
+    unlock_profile();
+    // only now that the lock is released can we make an object
+    char *res = str_new(b.s);
+    free(b.s);
+    return res;
+}
+
+/// what a profile reports.
+// @field OBJ_PROFILE_LIVE bytes still alive
+// @field OBJ_PROFILE_ALLOCATED bytes allocated
+// @field OBJ_PROFILE_FREED bytes freed
+// @table ObjProfileKind
+// @within Profiling
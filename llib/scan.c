@@ -460,6 +460,15 @@ char *scan_get_str(ScanState* ts)
     return str_new(buff);
 }
 
+/// view of the current token.
+// Nothing is copied, so the view is only good until the scanner reads
+// another line. See `str_view`.
+// @within Getting
+StrView scan_get_view(ScanState* ts)
+{
+    return str_view_len(ts->start_P,(int)(ts->end_P - ts->start_P));
+}
+
 #define str_eq(s1,s2) (strcmp((s1),(s2))==0)
 
 /// Formatted reading from the scanner, like `scanf`.
@@ -1,7 +1,7 @@
 #ifndef LLIB_SCAN_H
 #define LLIB_SCAN_H
 #include <stdio.h>
-#include "obj.h"
+#include "str.h"
 
 enum {
    T_END, T_EOF=0,
@@ -65,6 +65,7 @@ char *scan_get_line(ScanState *ts, char *buff, int len);
 const char *scan_next_line(ScanState *ts);
 char *scan_get_tok(ScanState* ts, char *tok, int len);
 char *scan_get_str(ScanState* ts);
+StrView scan_get_view(ScanState* ts);
 double scan_get_number(ScanState* ts);
 bool scan_scanf(ScanState* ts, const char *fmt,...);
 bool scan_skip_until(ScanState *ts, ScanTokenType type);
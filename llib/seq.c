@@ -105,3 +105,36 @@ void seq_adda(void *sp, void *buff, int sz) {
     }
     array_len(s->arr) = lass;
 }
+
+void seq_reserve(void *sp, int n) {
+    Seq *s = (Seq *)sp;
+    if (n <= s->cap)
+        return;
+    int len = array_len(s->arr);
+    s->arr = array_resize(s->arr,n);
+    s->cap = n;
+    array_len(s->arr) = len;
+}
+
+void seq_shrink_to_fit(void *sp) {
+    Seq *s = (Seq *)sp;
+    int len = array_len(s->arr);
+    if (len < s->cap) {
+        s->arr = array_resize(s->arr,len);
+        s->cap = len;
+    }
+}
+
+int seq_add_n(void *sp, const void *items, int n) {
+    Seq *s = (Seq *)sp;
+    int len = array_len(s->arr), mlem = obj_elem_size(s->arr);
+    if (len + n > s->cap)
+        seq_resize(s,len + n);
+    char *P = (char*)s->arr + len*mlem;
+    if (items)
+        memcpy(P,items,n*mlem);
+    else
+        memset(P,0,n*mlem);
+    array_len(s->arr) = len + n;
+    return len;
+}
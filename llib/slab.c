@@ -0,0 +1,292 @@
+/*
+* llib little C library
+* BSD licence
+* Copyright Steve Donovan, 2013
+*/
+
+/***
+### Size-class Allocator for Small Objects.
+
+Most llib objects are small: short strings, boxed values, map and list
+objects. Rather than going to `malloc` for each of these, `new_obj` asks
+this module for a slot of the right _size class_. Each class keeps a free list
+of slots, which are carved from large chunks. Chunks are aligned on their own
+size, so that the chunk (and hence the size class) of any slot can be found by
+masking its address.
+
+Objects larger than the biggest class go to `malloc` as before. The header of
+each object records which allocator was used, so that `obj_free_` can return
+it to the right place, even if the allocator was switched off in the meantime.
+
+Each chunk keeps a bitmap of where its live objects start, and all chunks are
+kept in a hash set, so that `obj_refcount` can cheaply tell whether a pointer
+is one of ours.
+
+Build with `LLIB_NO_SLAB` to use plain `malloc` throughout, or switch at
+runtime with `obj_slab_enable`.
+
+With `LLIB_THREADS`, each thread has its own size classes, so allocation
+never takes a lock. A slot freed by another thread goes onto that thread's free list.
+Note that slots cached by a thread are not given back when it exits.
+
+See `bench/bench-alloc.c`.
+
+@module slab
+*/
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200112L
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "obj.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#define aligned_alloc_(sz) _aligned_malloc(sz,SLAB_CHUNK)
+#else
+static void *aligned_alloc_(size_t sz) {
+    void *p;
+    if (posix_memalign(&p,SLAB_CHUNK,sz) != 0)
+        return NULL;
+    return p;
+}
+#endif
+
+// slot sizes (including the object header) go up in steps of 16 bytes until 128,
+// and then in steps of 32 and 64.
+static const int class_sizes[SLAB_CLASSES] = {
+    16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256,
+    320, 384, 448, 512
+};
+
+typedef struct SlabChunk_ SlabChunk;
+
+// one bit for each 16-byte granule of a chunk
+#define GRANULES (SLAB_CHUNK/16)
+
+struct SlabChunk_ {
+    SlabChunk *next;
+    int cls;
+    int used;
+    unsigned int live[GRANULES/32]; // set where a live object starts
+};
+
+// chunk header is padded so that slots stay 16-byte aligned
+#define CHUNK_HEADER ((sizeof(SlabChunk) + 15) & ~15)
+
+typedef struct SlabClass_ {
+    void *free_list;
+    char *bump, *bump_end; // unused tail of the newest chunk
+    SlabChunk *chunks;
+    int size;
+    int nchunks;
+    int used;
+} SlabClass;
+
+static LLIB_TLS SlabClass s_classes[SLAB_CLASSES];
+
+// maps (size+15)/16 onto a class index
+static const unsigned char class_of_16[SLAB_MAX_SIZE/16 + 1] = {
+    0, 0, 1, 2, 3, 4, 5, 6, 7,
+    8, 8, 9, 9, 10, 10, 11, 11,
+    12, 12, 12, 12, 13, 13, 13, 13,
+    14, 14, 14, 14, 15, 15, 15, 15
+};
+
+#ifdef LLIB_NO_SLAB
+static bool s_enabled = false;
+#else
+static bool s_enabled = true;
+#endif
+static LLIB_TLS bool s_initialized = false;
+
+static void slab_initialize() {
+    s_initialized = true;
+    FOR(i,SLAB_CLASSES) {
+        s_classes[i].size = class_sizes[i];
+    }
+}
+
+#define chunk_of(p) ((SlabChunk*)((uintptr_t)(p) & ~(uintptr_t)(SLAB_CHUNK-1)))
+#define granule_of(ch,p) ((unsigned int)((char*)(p) - (char*)(ch)) >> 4)
+
+// All chunks are registered in an open-addressed set. Chunks are never released,
+// so entries are only ever added, and this can be read and updated without locks.
+#define MAX_CHUNKS 65536
+
+static SlabChunk *s_chunk_set[MAX_CHUNKS];
+static int s_nchunks;
+static bool s_chunks_full; // no more chunks, so new objects come from malloc
+
+#define hash_chunk(ch) ((unsigned int)((uintptr_t)(ch) >> 16) * 2654435761u)
+
+// claim a place in the set for a new chunk, keeping the set at most half full
+static bool reserve_chunk(void) {
+    if (obj_atomic_add_(&s_nchunks,1) > MAX_CHUNKS/2) {
+        obj_atomic_add_(&s_nchunks,-1);
+        obj_atomic_store_(&s_chunks_full,true);
+        return false;
+    }
+    return true;
+}
+
+static void register_chunk(SlabChunk *ch) {
+    for (unsigned int i = hash_chunk(ch); ; ++i) {
+        if (obj_atomic_cas_ptr_(&s_chunk_set[i & (MAX_CHUNKS-1)],NULL,ch))
+            return;
+    }
+}
+
+static bool new_chunk(SlabClass *sc, int cls) {
+    if (obj_atomic_load_(&s_chunks_full) || ! reserve_chunk())
+        return false;
+    SlabChunk *ch = (SlabChunk*)aligned_alloc_(SLAB_CHUNK);
+    if (! ch) {
+        obj_atomic_add_(&s_nchunks,-1);
+        return false;
+    }
+    memset(ch->live,0,sizeof(ch->live));
+    register_chunk(ch);
+    ch->cls = cls;
+    ch->used = 0;
+    ch->next = sc->chunks;
+    sc->chunks = ch;
+    ++sc->nchunks;
+    sc->bump = (char*)ch + CHUNK_HEADER;
+    sc->bump_end = (char*)ch + SLAB_CHUNK;
+    return true;
+}
+
+// called by `new_obj`. Returns NULL if the size is too big for us, or we're switched off
+void *obj_slab_alloc_(int size) {
+    if (! s_enabled || size > SLAB_MAX_SIZE)
+        return NULL;
+    if (! s_initialized)
+        slab_initialize();
+    int cls = class_of_16[(size + 15) >> 4];
+    SlabClass *sc = &s_classes[cls];
+    void *p = sc->free_list;
+    if (p) {
+        sc->free_list = *(void**)p;
+    } else {
+        if (sc->bump + sc->size > sc->bump_end) {
+            if (! new_chunk(sc,cls))
+                return NULL;
+        }
+        p = sc->bump;
+        sc->bump += sc->size;
+    }
+    ++sc->used;
+    SlabChunk *ch = chunk_of(p);
+    unsigned int g = granule_of(ch,p);
+    obj_atomic_or_(&ch->live[g >> 5],1u << (g & 31));
+    obj_atomic_add_(&ch->used,1);
+    return p;
+}
+
+// called by `obj_free_` for objects which have been allocated here
+void obj_slab_free_(void *p) {
+    if (! s_initialized)
+        slab_initialize();
+    SlabChunk *ch = chunk_of(p);
+    SlabClass *sc = &s_classes[ch->cls];
+    unsigned int g = granule_of(ch,p);
+    obj_atomic_and_(&ch->live[g >> 5],~(1u << (g & 31)));
+    *(void**)p = sc->free_list;
+    sc->free_list = p;
+    --sc->used;
+    obj_atomic_add_(&ch->used,-1);
+}
+
+// the size of the slot holding an object header
+int obj_slab_size_(void *p) {
+    return class_sizes[chunk_of(p)->cls];
+}
+
+// does this pointer (an object header) lie in one of our chunks? If so, return
+// 1 if it is a live object and 0 otherwise; if not, return -1.
+int obj_slab_owns_(void *p) {
+    SlabChunk *ch = chunk_of(p);
+    if (ch == NULL) // small integers are often passed as pointers
+        return -1;
+    for (unsigned int i = hash_chunk(ch); ; ++i) {
+        SlabChunk *c = obj_atomic_load_(&s_chunk_set[i & (MAX_CHUNKS-1)]);
+        if (c == ch)
+            break;
+        if (c == NULL)
+            return -1;
+    }
+    if (((uintptr_t)p & 15) != 0 || (char*)p < (char*)ch + CHUNK_HEADER)
+        return 0;
+    unsigned int g = granule_of(ch,p);
+    return (obj_atomic_load_(&ch->live[g >> 5]) >> (g & 31)) & 1;
+}
+
+// copy up to `max` live object headers into `out`, returning the number copied
+int obj_slab_live_(void **out, int max) {
+    int n = 0;
+    FOR(i,MAX_CHUNKS) {
+        SlabChunk *ch = obj_atomic_load_(&s_chunk_set[i]);
+        if (! ch)
+            continue;
+        FOR(w,GRANULES/32) {
+            unsigned int bits = obj_atomic_load_(&ch->live[w]);
+            for (int b = 0; bits; b++, bits >>= 1) {
+                if ((bits & 1) && n < max)
+                    out[n++] = (char*)ch + 16*(32*w + b);
+            }
+        }
+    }
+    return n;
+}
+
+/// switch the small-object allocator on or off.
+// Objects already allocated will still be freed correctly.
+// @within Allocation
+void obj_slab_enable(bool on) {
+    s_enabled = on;
+}
+
+/// occupancy of the size classes.
+// Returns an array of `SlabStats`, one for each size class.
+// With `LLIB_THREADS`, these are the classes of the calling thread.
+// @within Allocation
+SlabStats *obj_slab_stats() {
+    if (! s_initialized)
+        slab_initialize();
+    SlabStats *res = array_new(SlabStats,SLAB_CLASSES);
+    FOR(i,SLAB_CLASSES) {
+        SlabClass *sc = &s_classes[i];
+        SlabStats *st = &res[i];
+        st->size = sc->size;
+        st->chunks = sc->nchunks;
+        st->used = sc->used;
+        st->capacity = sc->nchunks * ((SLAB_CHUNK - CHUNK_HEADER) / sc->size);
+    }
+    return res;
+}
+
+/// print out occupancy of the size classes which are in use.
+// @within Allocation
+void obj_slab_dump() {
+    SlabStats *stats = obj_slab_stats();
+    printf("+++ llib slab classes\n");
+    FOR_ARR(SlabStats,st,stats) {
+        if (st->chunks > 0)
+            printf("%4d bytes: %d chunks, %d/%d used (%.1f%%)\n",st->size,st->chunks,
+                st->used,st->capacity,100.0*st->used/st->capacity);
+    }
+    printf("+++\n");
+    obj_unref(stats);
+}
+
+/// size class statistics.
+// @int size size of slots in this class (including object header)
+// @int chunks number of chunks allocated
+// @int used number of live slots
+// @int capacity total number of slots in the chunks
+// @table SlabStats
+// @within Allocation
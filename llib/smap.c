@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include "str.h"
 
 /// Simple Maps
@@ -11,13 +12,100 @@
 /// Simple Maps.
 // These are arrays of strings where the odd entries are keys
 // and the even entries are values, ending with a `NULL`.
+//
+// Lookup is a linear scan, which is fine for the usual handful of pairs.
+// A larger smap which is a refcounted array also gets a hash index of its keys,
+// built on the first lookup which gets past the first few pairs, and brought up to date
+// when pairs are added. The index goes with the array, or when it is resized.
+// So keys must not be changed in place once such an smap has been searched.
+// Keys are compared as pointers before strings, so smaps with interned keys
+// (see `str_intern`) looked up with interned names rarely call `strcmp`.
 // @section smap
 
+// smaps with more pairs than this may be indexed
+#define SMAP_SCAN 8
+
+typedef struct SmapSlot_ {
+    unsigned int hash;
+    int pos;  // position of the key, plus one; zero for an empty slot
+} SmapSlot;
+
+typedef struct SmapIndex_ {
+    int len;  // array length covered by the index
+    int count;
+    unsigned int mask;
+    SmapSlot *slots;
+} SmapIndex;
+
+typedef struct SmapLookup_ {
+    char **substs;
+    const char *name;
+    int pos;
+} SmapLookup;
+
+// the slot holding the key, or the empty slot where it would go
+static SmapSlot *index_find(SmapIndex *idx, char **substs, const char *name, unsigned int h) {
+    for (unsigned int i = h; ; i++) {
+        SmapSlot *s = &idx->slots[i & idx->mask];
+        if (! s->pos || (s->hash == h && (substs[s->pos-1] == name || strcmp(substs[s->pos-1],name) == 0)))
+            return s;
+    }
+}
+
+// index the pairs from `idx->len` on; the first of a repeated key wins, as with a scan
+static void index_add(SmapIndex *idx, char **substs, int len) {
+    int pos;
+    for (pos = idx->len; pos < len && substs[pos]; pos += 2) {
+        unsigned int h = str_hash(substs[pos]);
+        SmapSlot *s = index_find(idx,substs,substs[pos],h);
+        if (! s->pos) {
+            s->hash = h;
+            s->pos = pos + 1;
+            ++idx->count;
+        }
+    }
+    idx->len = pos;
+}
+
+// make or update the index, and look the name up; runs with the array's entry locked
+static void index_lookup(void **pextra, void *arg) {
+    SmapLookup *lk = (SmapLookup*)arg;
+    SmapIndex *idx = (SmapIndex*)*pextra;
+    int len = array_len(lk->substs);
+    if (idx && idx->len > len) { // pairs were removed
+        free(idx);
+        idx = NULL;
+    }
+    // at most half full
+    unsigned int nslots = 16;
+    while (nslots < (unsigned int)len)
+        nslots *= 2;
+    if (! idx || idx->mask + 1 < nslots) {
+        free(idx);
+        idx = (SmapIndex*)calloc(1,sizeof(SmapIndex) + nslots*sizeof(SmapSlot));
+        idx->slots = (SmapSlot*)(idx + 1);
+        idx->mask = nslots - 1;
+    }
+    if (idx->len < len)
+        index_add(idx,lk->substs,len);
+    *pextra = idx;
+    SmapSlot *s = index_find(idx,lk->substs,lk->name,str_hash(lk->name));
+    lk->pos = s->pos - 1;
+}
+
 /// Look up a string in a smap returning pointer to entry.
 void **str_lookup_ptr(char** substs, const char *name) {
-    for (char **S = substs;  *S; S += 2) {
+    int i = 0;
+    for (char **S = substs;  *S; S += 2, i++) {
+        if (i == SMAP_SCAN) { // a bigger smap; use the index if it can have one
+            SmapLookup lk;
+            lk.substs = substs;
+            lk.name = name;
+            if (obj_attachment_(substs,index_lookup,&lk))
+                return lk.pos >= 0 ? (void**)(substs + lk.pos + 1) : NULL;
+        }
         char *P = *S;
-        if (strcmp(P,name)==0)
+        if (P == name || strcmp(P,name)==0)
             return (void**)(S+1);
     }
     return NULL;
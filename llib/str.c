@@ -17,6 +17,10 @@
 // There are searching operations which return a boolean or integer index,
 // loosely based on C++'s `std::string` methods.
 //
+// A string ends at its first nul, even a refcounted one whose array is longer,
+// since buffers are often written or cut short in place. The `_len` variants
+// take an explicit length, so they also work with strings that contain nul bytes.
+//
 // _smaps_ ('simple maps') are arrays of strings where the odd indices
 // are keys and the even indices are values. `str_lookup` does a
 // linear search, which is simple and sufficient for small maps. A convenient
@@ -30,11 +34,307 @@
 #define _BSD_SOURCE
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "str.h"
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define STR_SSE2
+#endif
+
 #define BUFSZ 256
 
+// Scanning bytes. Sets of up to eight characters, like delimiters and
+// whitespace, are compared sixteen (SSE2) or thirty-two (AVX2) bytes
+// at a time. Larger sets are bitmaps; with AVX2, sets of more than four ASCII
+// characters are looked up by nibble with byte shuffles. AVX2 is chosen when the CPU has it.
+// The scans take lengths, so they never read past the end of a buffer.
+// A long refcounted string is scanned within its array, but it may end sooner,
+// so the searches on strings also stop at the first nul. Short and plain strings
+// are left to the C library, which can stop at the nul without knowing where it is.
+
+#if defined(STR_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define STR_AVX2 __attribute__((target("avx2")))
+#endif
+
+enum { SIMD_NONE, SIMD_SSE2, SIMD_AVX2 };
+
+// searching strings shorter than this is not worth the setup
+#define SHORT_LEN 64
+
+// up to this many characters of a set are compared in parallel, four at a time
+#define SET_SIMD_CHARS 8
+
+typedef struct ByteSet_ {
+    int n;
+    bool ascii;
+    char chars[SET_SIMD_CHARS];
+    unsigned char bits[32];    // bit per character
+    unsigned char nibbles[16]; // for each low nibble, a bit per high nibble up to 7
+} ByteSet;
+
+static int s_simd = -1;
+
+static int simd_detect() {
+#ifdef STR_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SIMD_AVX2;
+#endif
+#ifdef STR_SSE2
+    return SIMD_SSE2;
+#else
+    return SIMD_NONE;
+#endif
+}
+
+#define simd_level() (s_simd >= 0 ? s_simd : (s_simd = simd_detect()))
+
+/// limit the use of SIMD instructions by the string functions.
+// This is mostly for testing and benchmarking the fallbacks.
+// @int level 0 for none, 1 for SSE2, 2 for AVX2, or -1 to leave it alone
+// @return the level used, which is no more than the CPU supports
+int str_simd_level(int level) {
+    int best = simd_detect();
+    if (level >= 0)
+        s_simd = level < best ? level : best;
+    return simd_level();
+}
+
+// the set of `chars`; with `nul` the set also has the nul byte, so that a scan
+// for any of them stops at the end of a string
+static void byteset_init(ByteSet *set, str_t chars, bool nul) {
+    int n = strlen(chars);
+    set->n = n + nul;
+    set->ascii = true;
+    memset(set->bits,0,sizeof(set->bits));
+    memset(set->nibbles,0,sizeof(set->nibbles));
+    for (int i = 0; i < set->n; i++) {
+        unsigned char ch = i < n ? (unsigned char)chars[i] : 0;
+        set->bits[ch >> 3] |= 1 << (ch & 7);
+        if (ch & 0x80)
+            set->ascii = false;
+        else
+            set->nibbles[ch & 15] |= 1 << (ch >> 4);
+    }
+    // unused lanes repeat the last character
+    FOR(i,SET_SIMD_CHARS)
+        set->chars[i] = i < n ? chars[i] : n && ! nul ? chars[n - 1] : '\0';
+}
+
+#define byteset_has(set,ch) ((set)->bits[(unsigned char)(ch) >> 3] & (1 << ((ch) & 7)))
+
+// index of the first byte which is in the set (or not, if `in` is false), or `len`
+static int scan_set_bytes(const char *s, int len, const ByteSet *set, bool in) {
+    int i = 0;
+    while (i < len && (byteset_has(set,s[i]) != 0) != in)
+        ++i;
+    return i;
+}
+
+#ifdef STR_SSE2
+static int lowest_bit(unsigned int mask) {
+#ifdef __GNUC__
+    return __builtin_ctz(mask);
+#else
+    int i = 0;
+    while (! (mask & 1)) {
+        mask >>= 1;
+        ++i;
+    }
+    return i;
+#endif
+}
+
+// compared in line, since a call in the search loops makes the compiler keep
+// the vectors in memory
+static bool same_bytes(const char *a, const char *b, int n) {
+    for (int i = 0; i < n; i++)
+        if (a[i] != b[i])
+            return false;
+    return true;
+}
+
+static int scan_set_sse2(const char *s, int len, const ByteSet *set, bool in) {
+    int i = 0;
+    if (set->n > 0 && set->n <= SET_SIMD_CHARS) {
+        __m128i d0 = _mm_set1_epi8(set->chars[0]), d1 = _mm_set1_epi8(set->chars[1]);
+        __m128i d2 = _mm_set1_epi8(set->chars[2]), d3 = _mm_set1_epi8(set->chars[3]);
+        __m128i d4 = _mm_set1_epi8(set->chars[4]), d5 = _mm_set1_epi8(set->chars[5]);
+        __m128i d6 = _mm_set1_epi8(set->chars[6]), d7 = _mm_set1_epi8(set->chars[7]);
+        bool wide = set->n > 4;
+        unsigned int flip = in ? 0 : 0xFFFF;
+        for (; len - i >= 16; i += 16) {
+            __m128i x = _mm_loadu_si128((const __m128i*)(s + i));
+            __m128i m = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(x,d0),_mm_cmpeq_epi8(x,d1)),
+                _mm_or_si128(_mm_cmpeq_epi8(x,d2),_mm_cmpeq_epi8(x,d3)));
+            if (wide)
+                m = _mm_or_si128(m,_mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(x,d4),_mm_cmpeq_epi8(x,d5)),
+                    _mm_or_si128(_mm_cmpeq_epi8(x,d6),_mm_cmpeq_epi8(x,d7))));
+            unsigned int mask = _mm_movemask_epi8(m) ^ flip;
+            if (mask)
+                return i + lowest_bit(mask);
+        }
+    }
+    return i + scan_set_bytes(s + i,len - i,set,in);
+}
+
+// candidates match the first and last bytes of `sub`, and are then checked.
+// With `nul`, only candidates before the first nul count, and the search stops there
+static int find_sse2(const char *s, int len, const char *sub, int sublen, bool nul) {
+    __m128i first = _mm_set1_epi8(sub[0]), last = _mm_set1_epi8(sub[sublen-1]);
+    __m128i zero = _mm_setzero_si128();
+    unsigned int stops = nul ? 0xFFFF : 0;
+    int i = 0;
+    for (; i + sublen - 1 + 16 <= len; i += 16) {
+        __m128i bf = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i bl = _mm_loadu_si128((const __m128i*)(s + i + sublen - 1));
+        unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(bf,first),_mm_cmpeq_epi8(bl,last)));
+        unsigned int zeros = _mm_movemask_epi8(_mm_cmpeq_epi8(bf,zero)) & stops;
+        if (zeros)
+            mask &= zeros ^ (zeros - 1);
+        while (mask) {
+            int k = lowest_bit(mask);
+            if (same_bytes(s + i + k + 1,sub + 1,sublen - 2))
+                return i + k;
+            mask &= mask - 1;
+        }
+        if (zeros)
+            return i + lowest_bit(zeros);
+    }
+    return i;
+}
+#endif
+
+#ifdef STR_AVX2
+STR_AVX2 static int scan_set_avx2(const char *s, int len, const ByteSet *set, bool in) {
+    int i = 0;
+    if (set->n > 4 && set->ascii) {
+        __m256i nibbles = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)set->nibbles));
+        __m256i high_bits = _mm256_setr_epi8(1,2,4,8,16,32,64,-128,0,0,0,0,0,0,0,0,
+            1,2,4,8,16,32,64,-128,0,0,0,0,0,0,0,0);
+        __m256i low4 = _mm256_set1_epi8(0x0F), zero = _mm256_setzero_si256();
+        unsigned int flip = in ? 0xFFFFFFFF : 0;
+        for (; len - i >= 32; i += 32) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(s + i));
+            __m256i lo = _mm256_and_si256(x,low4), hi = _mm256_and_si256(_mm256_srli_epi16(x,4),low4);
+            __m256i m = _mm256_and_si256(_mm256_shuffle_epi8(nibbles,lo),_mm256_shuffle_epi8(high_bits,hi));
+            unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(m,zero)) ^ flip;
+            if (mask)
+                return i + lowest_bit(mask);
+        }
+    } else
+    if (set->n > 0 && set->n <= SET_SIMD_CHARS) {
+        __m256i d0 = _mm256_set1_epi8(set->chars[0]), d1 = _mm256_set1_epi8(set->chars[1]);
+        __m256i d2 = _mm256_set1_epi8(set->chars[2]), d3 = _mm256_set1_epi8(set->chars[3]);
+        __m256i d4 = _mm256_set1_epi8(set->chars[4]), d5 = _mm256_set1_epi8(set->chars[5]);
+        __m256i d6 = _mm256_set1_epi8(set->chars[6]), d7 = _mm256_set1_epi8(set->chars[7]);
+        bool wide = set->n > 4;
+        unsigned int flip = in ? 0 : 0xFFFFFFFF;
+        for (; len - i >= 32; i += 32) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(s + i));
+            __m256i m = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(x,d0),_mm256_cmpeq_epi8(x,d1)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(x,d2),_mm256_cmpeq_epi8(x,d3)));
+            if (wide)
+                m = _mm256_or_si256(m,_mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(x,d4),_mm256_cmpeq_epi8(x,d5)),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(x,d6),_mm256_cmpeq_epi8(x,d7))));
+            unsigned int mask = (unsigned int)_mm256_movemask_epi8(m) ^ flip;
+            if (mask)
+                return i + lowest_bit(mask);
+        }
+    }
+    return i + scan_set_sse2(s + i,len - i,set,in);
+}
+
+STR_AVX2 static int find_avx2(const char *s, int len, const char *sub, int sublen, bool nul) {
+    __m256i first = _mm256_set1_epi8(sub[0]), last = _mm256_set1_epi8(sub[sublen-1]);
+    __m256i zero = _mm256_setzero_si256();
+    unsigned int stops = nul ? 0xFFFFFFFF : 0;
+    int i = 0;
+    for (; i + sublen - 1 + 32 <= len; i += 32) {
+        __m256i bf = _mm256_loadu_si256((const __m256i*)(s + i));
+        __m256i bl = _mm256_loadu_si256((const __m256i*)(s + i + sublen - 1));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(bf,first),_mm256_cmpeq_epi8(bl,last)));
+        unsigned int zeros = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bf,zero)) & stops;
+        if (zeros)
+            mask &= zeros ^ (zeros - 1);
+        while (mask) {
+            int k = lowest_bit(mask);
+            if (same_bytes(s + i + k + 1,sub + 1,sublen - 2))
+                return i + k;
+            mask &= mask - 1;
+        }
+        if (zeros)
+            return i + lowest_bit(zeros);
+    }
+    return i;
+}
+#endif
+
+// index of the first byte of `s` which is in the set (or not), or `len`
+static int scan_set(const char *s, int len, const ByteSet *set, bool in) {
+#ifdef STR_AVX2
+    if (simd_level() == SIMD_AVX2)
+        return scan_set_avx2(s,len,set,in);
+#endif
+#ifdef STR_SSE2
+    if (simd_level() >= SIMD_SSE2)
+        return scan_set_sse2(s,len,set,in);
+#endif
+    return scan_set_bytes(s,len,set,in);
+}
+
+// the array length of a long refcounted string, or -1. This bounds the string
+// without scanning it, but the string may end at an earlier nul
+static int long_bound(str_t s) {
+    if (strnlen(s,SHORT_LEN) < SHORT_LEN)
+        return -1;
+    if (obj_refcount(s) != -1 && obj_is_array(s) && obj_elem_size(s) == 1)
+        return str_len(s);
+    return -1;
+}
+
+// index of `sub` in `s`, or -1. The vector search returns a match, or where
+// it stopped, and the rest is searched by memchr on the first byte; with `nul`,
+// `s` ends at its first nul and the rest is left to strstr.
+static int find_bytes(const char *s, int len, const char *sub, int sublen, bool nul) {
+    if (sublen == 0)
+        return 0;
+    int i = 0;
+    if (sublen >= 2) {
+#ifdef STR_AVX2
+        if (simd_level() == SIMD_AVX2)
+            i = find_avx2(s,len,sub,sublen,nul);
+        else
+#endif
+#ifdef STR_SSE2
+        if (simd_level() >= SIMD_SSE2)
+            i = find_sse2(s,len,sub,sublen,nul);
+#endif
+    }
+    const char *P = s + i, *E = s + len - sublen;
+    if (nul) {
+        P = strstr(P,sub);
+        return P ? (int)(P - s) : -1;
+    }
+    while (P <= E) {
+        P = (const char*)memchr(P,*sub,E - P + 1);
+        if (! P)
+            break;
+        if (memcmp(P,sub,sublen) == 0)
+            return (int)(P - s);
+        ++P;
+    }
+    return -1;
+}
+
 /// String buffers.
 // @section buffers
 
@@ -71,6 +371,11 @@ void strbuf_adds(char **sp, str_t ss) {
     sb_adds(sp,ss,strlen(ss));
 }
 
+/// append `len` bytes to a string buffer.
+void strbuf_adds_len(char **sp, str_t ss, int len) {
+    sb_adds(sp,ss,len);
+}
+
 /// append formatted results to a string buffer.
 // Note that the result must be less than `BUFSZ` (default 256)
 void strbuf_addf(char **sp, str_t fmt, ...) {
@@ -104,7 +409,8 @@ char *strbuf_insert_at(char **sp, int pos, str_t src, int sz) {
     Seq *s = (Seq *)sp;
     int on = array_len(s->arr), len = sz==-1 ? strlen(src) : sz;
     // make some room!
-    seq_resize(s, on + sz);
+    seq_resize(s, on + len);
+    array_len(s->arr) = on + len;
     char *P = (char*)s->arr + pos; // insertion point
     // move rest of string up
     memmove(P+len,P,on-pos+1);
@@ -119,7 +425,8 @@ char *strbuf_erase(char **sp, int pos, int len) {
     char *P = (char*)s->arr;
     int on = array_len(P);
     P += pos;
-    memmove(P,P+len,on-pos+1);
+    memmove(P,P+len,on-pos-len+1);
+    array_len(s->arr) = on - len;
     return (char*)s->arr;
 }
 
@@ -174,7 +481,7 @@ char *str_fmt(str_t fmt, ...) {
 // @usage str_sub("hello",2,3) -> "l"
 // @usage str_sub("hello",2,-1) -> "llo"
 char* str_sub(str_t s, int i1, int i2) {
-     int sz = strlen(s);
+    int sz = strlen(s);
     if (i2 < 0)
         i2 = sz + i2 + 1;
     if (i1 < 0)
@@ -191,15 +498,24 @@ char* str_sub(str_t s, int i1, int i2) {
 
 static str_t whitespace = " \t\r\n";
 
+// the same characters as a set: tab, newline and return are bits 1, 2 and 5
+// of the second byte, and space is bit 0 of the fifth
+static const ByteSet s_blanks = {4, true, {' ','\t','\r','\n','\n','\n','\n','\n'}, {0,0x26,0,0,0x01},
+    {0x04,0,0,0,0,0,0,0,0,0x01,0x01,0,0,0x01,0,0}};
+
 /// trim a string in-place
+// The length of a refcounted string is updated.
 void str_trim(char *s) {
-    int sz = strspn(s,whitespace);
-    if (sz > 0)
-        memmove(s,s+sz,strlen(s)-sz+1);
-    char *p = s + strlen(s) - 1;
-    while (*p && strchr(whitespace,*p) != NULL)
-        --p;
-    *(p+1) = 0;
+    int len = strlen(s), sz = scan_set(s,len,&s_blanks,false);
+    if (sz > 0) {
+        len -= sz;
+        memmove(s,s+sz,len+1);
+    }
+    while (len > 0 && strchr(whitespace,s[len-1]) != NULL)
+        --len;
+    s[len] = 0;
+    if (obj_refcount(s) != -1)
+        str_len(s) = len;
 }
 
 /// Finding things in strings.
@@ -226,26 +542,32 @@ bool str_starts_with(str_t s, str_t prefix) {
 
 /// does the string end with this postfix?
 bool str_ends_with(str_t s, str_t postfix) {
-    str_t se = str_end(s);
-    str_t pe = str_end(postfix);
-    while (se != s && pe != postfix) {
-        if (*se != *pe)
-            return false;
-        --se;
-        --pe;
-    }
-    return pe == postfix;
+    int ls = strlen(s), lp = strlen(postfix);
+    return lp <= ls && memcmp(s + ls - lp,postfix,lp) == 0;
 }
 
 /// does a string only consist of blank characters?
 bool str_is_blank(str_t s) {
-    return strspn(s,whitespace) == strlen(s);
+    int len = long_bound(s);
+    if (len < 0)
+        return s[strspn(s,whitespace)] == '\0';
+    int i = scan_set(s,len,&s_blanks,false);
+    return i == len || s[i] == '\0';
 }
 
 /// find substring `sub` in the string.
 int str_findstr(str_t s, str_t sub) {
-    str_t P = strstr(s,sub);
-    return offset_str(P,s);
+    int len = long_bound(s);
+    if (len < 0)
+        return offset_str(strstr(s,sub),s);
+    return find_bytes(s,len,sub,strlen(sub),true);
+}
+
+/// find `sublen` bytes `sub` in the first `len` bytes of `s`.
+// Either may contain nul bytes.
+// @return index of the match, or -1
+int str_findstr_len(str_t s, int len, str_t sub, int sublen) {
+    return find_bytes(s,len,sub,sublen,false);
 }
 
 /// contains substring?
@@ -269,12 +591,25 @@ int str_findch(str_t s, char ch) {
 
 /// find first character that is in the string `ps`
 int str_find_first_of(str_t s, str_t ps) {
-    return offset_str(strpbrk(s,ps),s);
+    int len = long_bound(s);
+    if (len < 0)
+        return offset_str(strpbrk(s,ps),s);
+    ByteSet set;
+    byteset_init(&set,ps,true);
+    int i = scan_set(s,len,&set,true);
+    return i < len && s[i] ? i : -1;
 }
 
 /// find first character that is _not_ in the string `ps`
 int str_find_first_not_of(str_t s, str_t ps) {
-    int sz = strspn(s,ps);
+    int len = long_bound(s), sz;
+    if (len < 0) {
+        sz = strspn(s,ps);
+    } else {
+        ByteSet set;
+        byteset_init(&set,ps,false);
+        sz = scan_set(s,len,&set,false); // stops at the nul
+    }
     if (sz == 0)
         return -1;
     else
@@ -342,26 +677,75 @@ char ** str_split(str_t s, str_t delim) {
 	return str_split_n(s,delim,0);
 }
 
+/// split a string using delimiters, in one allocation.
+// The fields are nul-terminated pieces of a copy of `s` kept in the same block
+// as the array, so the whole result goes with one `unref`. The fields are
+// _not_ refcounted strings; use `str_ref` or `str_cpy` to keep one.
+// @param s the string
+// @param delim the delimiter characters
+// @int how the most splits to make, or zero for no limit, with
+// `STR_EMPTY` to keep empty fields. Otherwise runs of delimiters
+// separate fields, as with `str_split`.
+// @return a `NULL`-terminated array of strings
+char **str_split_block(str_t s, str_t delim, int how) {
+    bool empty = (how & STR_EMPTY) != 0;
+    int nsplit = how & 0xFF, len = strlen(s);
+    ByteSet d;
+    byteset_init(&d,delim,false);
+
+    // there is at most one more field than there are delimiters
+    int n = 1;
+    for (int i = scan_set(s,len,&d,true); i < len; i += 1 + scan_set(s + i + 1,len - i - 1,&d,true))
+        ++n;
+    int words = n + 1 + (len + sizeof(char*))/sizeof(char*);
+    char **res = array_new(char*,words);
+    char *P = (char*)(res + n + 1), *E = P + len;
+    memcpy(P,s,len);
+    *E = '\0';
+
+    int k = 0;
+    while (true) {
+        if (! empty) {
+            P += scan_set(P,E - P,&d,false);
+            if (P == E)
+                break;
+        }
+        res[k++] = P;
+        if (nsplit && k > nsplit) // the rest is the last field
+            break;
+        char *Q = P + scan_set(P,E - P,&d,true);
+        if (Q == E)
+            break;
+        *Q = '\0';
+        P = Q + 1;
+    }
+    res[k] = NULL;
+    array_len(res) = k;
+    return res;
+}
+
+// the lengths of this many strings are kept on the stack
+#define CONCAT_SIZES 64
+
 /// concatenate an array of strings.
 // Assumes that the array is refcounted
 char *str_concat(char **ss, str_t delim) {
     int sz = 0, nm1, n = array_len(ss), nd = delim ? strlen(delim) : 0;
     char *res, *q;
-    int **ssizes = seq_new(int);
-    int *sizes;
+    int ssizes[CONCAT_SIZES];
+    int *sizes = n <= CONCAT_SIZES ? ssizes : (int*)malloc(n*sizeof(int));
 
     // our total size for allocation
     FOR (i,n) {
         int len = strlen(ss[i]);
-        seq_add(ssizes,len);
+        sizes[i] = len;
         sz += len;
-        if (delim)
+        if (delim && i > 0)
             sz += nd;
     }
 
     res = str_new_size(sz);
     q = res;
-    sizes = *ssizes;
     nm1 = n - 1;
     FOR (i,n) {
         memcpy(q,ss[i],sizes[i]);
@@ -372,7 +756,8 @@ char *str_concat(char **ss, str_t delim) {
         }
     }
     *q = '\0';
-    obj_unref(ssizes);
+    if (sizes != ssizes)
+        free(sizes);
     return res;
 }
 
@@ -391,12 +776,12 @@ char *str_replace_str(str_t s, str_t sub, str_t repl, int how) {
         return (char*)str_ref(s);
     int n = how & 0xFF;
     if (n == 0) n = 0xFFFF;
-    int slen = all ? strlen(sub) : 1;
+    int slen = all ? strlen(sub) : 1, rlen = strlen(repl);
     char** res = strbuf_new();
     for (int i = 0; i < n; ++i) {
         // copy up to the point of substitution, and skip it
-        for (; s != pos; s++) strbuf_add(res,*s);
-        s += slen;
+        sb_adds(res,s,pos - s);
+        s = pos + slen;
         // insert the substitution and find the next match
         if (pat) { // replace '%1' with whatever is found
             for (str_t R=repl; *R; ++R) {
@@ -412,7 +797,7 @@ char *str_replace_str(str_t s, str_t sub, str_t repl, int how) {
                 }
             }
         } else {
-            strbuf_adds(res,repl);
+            sb_adds(res,repl,rlen);
         }
         pos = find(s,sub);
         if (! pos)
@@ -484,3 +869,136 @@ int str_eq_any_ (const char *s, ...) {
     return res;
 }
 
+
+/// String Views.
+// A view is a pointer and a length into some other string, so taking
+// substrings, trimming and splitting need not allocate. Views do not own
+// their characters and are not nul-terminated: the string they look into
+// must outlive them, and `str_view_str` makes a real string when one is needed.
+// Print a view with `printf("%.*s",v.len,v.str)`.
+// @section views
+
+/// a view of a whole string.
+StrView str_view(str_t s) {
+    StrView v;
+    v.str = s;
+    v.len = strlen(s);
+    return v;
+}
+
+/// a view of `len` characters from `s`.
+StrView str_view_len(str_t s, int len) {
+    StrView v;
+    v.str = s;
+    v.len = len;
+    return v;
+}
+
+/// a refcounted copy of a view.
+char *str_view_str(StrView v) {
+    return str_new_len(v.str,v.len);
+}
+
+/// a view of part of a view.
+// Indices work as with `str_sub`, but nothing is copied.
+StrView str_view_sub(StrView v, int i1, int i2) {
+    int sz = v.len;
+    if (i2 < 0)
+        i2 = sz + i2 + 1;
+    if (i1 < 0)
+        i1 = sz + i1 + 1;
+    if (i1 > sz)
+        i1 = sz;
+    if (i2 > sz)
+        i2 = sz;
+    if (i2 < i1)
+        i2 = i1;
+    return str_view_len(v.str + i1,i2 - i1);
+}
+
+/// a view without the blank characters at either end.
+StrView str_view_trim(StrView v) {
+    int sz = scan_set(v.str,v.len,&s_blanks,false);
+    v.str += sz;
+    v.len -= sz;
+    while (v.len > 0 && byteset_has(&s_blanks,v.str[v.len-1]))
+        --v.len;
+    return v;
+}
+
+/// does the view hold exactly this string?
+bool str_view_eq(StrView v, str_t s) {
+    return (int)strlen(s) == v.len && memcmp(v.str,s,v.len) == 0;
+}
+
+/// find substring `sub` in a view.
+// @return index, or -1
+int str_view_findstr(StrView v, str_t sub) {
+    return str_findstr_len(v.str,v.len,sub,strlen(sub));
+}
+
+/// find character `ch` in a view.
+// @return index, or -1
+int str_view_findch(StrView v, char ch) {
+    return offset_str((str_t)memchr(v.str,ch,v.len),v.str);
+}
+
+// is this character one of the delimiters?
+static bool is_delim(str_t delim, char ch) {
+    return ch && strchr(delim,ch) != NULL;
+}
+
+/// the next field of a view, split by delimiters.
+// As with `str_split`, runs of delimiters separate fields, so there are
+// no empty fields. `rest` is advanced past the field.
+// @param rest the part of the view still to split
+// @param delim the delimiter characters
+// @param field the field found
+// @return `false` if there are no more fields
+bool str_view_next(StrView *rest, str_t delim, StrView *field) {
+    str_t P = rest->str, E = P + rest->len;
+    while (P < E && is_delim(delim,*P))
+        ++P;
+    if (P == E) {
+        rest->str = P;
+        rest->len = 0;
+        return false;
+    }
+    str_t Q = P;
+    if (delim[0] && ! delim[1]) { // a single delimiter
+        Q = (str_t)memchr(P,delim[0],E - P);
+        if (! Q)
+            Q = E;
+    } else {
+        while (Q < E && ! is_delim(delim,*Q))
+            ++Q;
+    }
+    *field = str_view_len(P,Q - P);
+    rest->str = Q;
+    rest->len = E - Q;
+    return true;
+}
+
+/// iterate over the fields of a string.
+// Nothing is allocated; `f` is a `StrView`.
+// @param f the field variable
+// @param s the string
+// @param delim the delimiter characters
+// @macro FOR_STR_VIEW_SPLIT
+
+/// split a string into views using delimiters.
+// Like `str_split`, but the result is one array of views into `s`, rather than
+// an array of new strings.
+// @return array of `StrView`
+StrView *str_view_split(str_t s, str_t delim) {
+    StrView rest = str_view(s), field;
+    int n = 0;
+    while (str_view_next(&rest,delim,&field))
+        ++n;
+    StrView *res = array_new(StrView,n);
+    rest = str_view(s);
+    n = 0;
+    while (str_view_next(&rest,delim,&field))
+        res[n++] = field;
+    return res;
+}
@@ -13,7 +13,7 @@
 // easier to type ;)
 typedef const char * str_t;
 
-enum {STR_ALL=1024,STR_ANY=2048,STR_PAT=4096};
+enum {STR_ALL=1024,STR_ANY=2048,STR_PAT=4096,STR_EMPTY=8192};
 
 #ifndef STRLOOKUP_DEFINED
 typedef char *(*StrLookup) (void *obj, const char *key);
@@ -39,6 +39,7 @@ char** smap_close(char*** smap);
 char *str_vfmt(str_t fmt,va_list ap);
 char *str_fmt(str_t fmt,...);
 int str_findstr(str_t s, str_t sub);
+int str_findstr_len(str_t s, int len, str_t sub, int sublen);
 bool str_contains(str_t s, str_t sub, int *after);
 int str_findch(str_t s, char ch);
 str_t str_end(str_t s);
@@ -53,10 +54,12 @@ char *str_replace_str(str_t s, str_t sub, str_t repl, int how);
 char* str_sub(str_t s, int i1, int i2);
 char ** str_split_n(str_t s, str_t delim, int nsplit);
 char ** str_split(str_t s, str_t delim);
+char **str_split_block(str_t s, str_t delim, int how);
 char *str_concat(char **ss, str_t delim);
 char **str_strings(char *p,...);
 int str_eq_any_ (const char *s, ...);
 int str_index(const char **strings, const char *s);
+int str_simd_level(int level);
 
 #define str_eq_any(s,...) str_eq_any_(s,__VA_ARGS__,NULL)
 
@@ -67,6 +70,7 @@ char *str_gets(SMap substs, str_t name);
 char **strbuf_new(void);
 #define strbuf_add seq_add
 void strbuf_adds(char **sp, str_t ss);
+void strbuf_adds_len(char **sp, str_t ss, int len);
 void strbuf_addsp(char **ss, str_t s);
 void strbuf_addf(char **sp, str_t fmt, ...);
 void strbuf_addr(char **sp, str_t s, int i1, int i2);
@@ -75,4 +79,23 @@ char *strbuf_erase(char **sp, int pos, int len);
 char *strbuf_replace(char **sp, int pos, int len, str_t s);
 #define strbuf_tostring(sp) (char*)seq_array_ref(sp)
 
+typedef struct StrView_ {
+    const char *str;  // not nul-terminated
+    int len;
+} StrView;
+
+StrView str_view(str_t s);
+StrView str_view_len(str_t s, int len);
+char *str_view_str(StrView v);
+StrView str_view_sub(StrView v, int i1, int i2);
+StrView str_view_trim(StrView v);
+bool str_view_eq(StrView v, str_t s);
+int str_view_findstr(StrView v, str_t sub);
+int str_view_findch(StrView v, char ch);
+bool str_view_next(StrView *rest, str_t delim, StrView *field);
+StrView *str_view_split(str_t s, str_t delim);
+
+#define FOR_STR_VIEW_SPLIT(f,s,delim) for (StrView r_##f = str_view(s), f; \
+ str_view_next(&r_##f,delim,&f); )
+
 #endif
@@ -190,6 +190,23 @@ bool table_generate_columns (Table *T) {
     return true;
 }
 
+static Strings strings_copy(Strings s, int n) {
+    Strings res = array_new_ref(Str,n);
+    FOR(i,n) {
+        res[i] = str_new(s[i]);
+    }
+    return res;
+}
+
+// the fields of a line, keeping empty ones. Like the rows added by `table_add_row`,
+// these are refcounted strings
+static Strings split_fields(Table *T, const char *line) {
+    Strings fields = str_split_block(line,T->delim,STR_EMPTY);
+    Strings res = strings_copy(fields,array_len(fields));
+    obj_unref(fields);
+    return res;
+}
+
 /// Read all of a table into rows.
 // If flag has `TableColumns` set, create columns as well.
 bool table_read_all(Table *T) {
@@ -205,10 +222,10 @@ bool table_read_all(Table *T) {
     }
     T->nrows = nrows;
 
-    // and split these lines into the rows
+    // and split these lines into the rows; empty fields are kept
     T->rows = array_new_ref(Strings,nrows);
     FOR (i,nrows) {
-        Strings row  = str_split(lines[i],T->delim);
+        Strings row  = split_fields(T,lines[i]);
         int ncol = array_len(row);
         if (! ncols) {
             ncols = ncol;
@@ -227,7 +244,9 @@ bool table_read_all(Table *T) {
 
 void table_read_col_names(Table *T) {
     if (T->opts & TableColumnNames) {
-        T->col_names = str_split(file_getline(T->in),T->delim);
+        char *line = file_getline(T->in);
+        T->col_names = split_fields(T,line);
+        obj_unref(line);
     }
     if (T->opts & TableAll) {
         table_read_all(T);
@@ -235,14 +254,6 @@ void table_read_col_names(Table *T) {
     //return T;
 }
 
-static Strings strings_copy(Strings s, int n) {
-    Strings res = array_new_ref(Str,n);
-    FOR(i,n) {
-        res[i] = str_new(s[i]);
-    }
-    return res;
-}
-
 /// explicitly add new rows to a table.
 int table_add_row(void *d, int ncols, char **row, char **columns) {
     Table *T = (Table*)d;
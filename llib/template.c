@@ -237,6 +237,8 @@ StrTempl *str_templ_new(const char *templ, const char *markers) {
         T = S + 1;
         if (! *T) break;
     }
+    // the first part is our copy, which has been cut short
+    str_len(stl->str) = strlen(stl->str);
     stl->parts = (Str*)seq_array_ref(ss);
     return stl;
 error:
@@ -19,11 +19,15 @@ Error values are strings with a distinct type, so we have `value_error` and  `va
 convert a value to a default string representation.  More complicated value types like arrays
 don't have a unique representation as strings, so see `json_tostring` and `xml_tostring`.
 
+`value_type_stats` presents the allocation statistics of `obj_type_stats` as a value,
+which can be written out with `json_tostring`.
+
 See `test-json.c` for how values are used in practice.
 
 */
 
 #include "value.h"
+#include "str.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -193,3 +197,57 @@ const char *value_tostring(PValue v) {
     return S(buff);
 }
 
+
+/// Statistics
+// @section stats
+
+static PValue *simple_map(int n) {
+    PValue *res = array_new_ref(PValue,2*n);
+    obj_set_type(res,OBJ_KEYVALUE_T);
+    return res;
+}
+
+/// allocation statistics as a value.
+// A simple map from type names to simple maps with the fields of
+// `ObjTypeStats`: the counts `live`, `allocs`, `bytes` and `peak`, and
+// `lengths`, an array of counts of arrays by length in powers of two
+// (up to the largest length seen). A type which shares its name with an
+// earlier one is called NAME#INDEX.
+// @bool all include types which have never been allocated
+PValue value_type_stats(bool all) {
+    ObjTypeStats *stats = obj_type_stats(all);
+    int n = array_len(stats);
+    PValue *res = simple_map(n);
+    FOR(i,n) {
+        ObjTypeStats *st = &stats[i];
+        char *name = str_new(st->name);
+        FOR(j,i) {
+            if (str_eq(stats[j].name,st->name)) {
+                obj_unref(name);
+                name = str_fmt("%s#%d",st->name,st->type);
+                break;
+            }
+        }
+        int nl = OBJ_LEN_BUCKETS;
+        while (nl > 0 && st->lengths[nl-1] == 0)
+            --nl;
+        PValue *lengths = array_new_ref(PValue,nl);
+        FOR(k,nl)
+            lengths[k] = value_int(st->lengths[k]);
+        PValue *fields = simple_map(5);
+        fields[0] = str_new("live");
+        fields[1] = value_int(st->live);
+        fields[2] = str_new("allocs");
+        fields[3] = value_int(st->allocs);
+        fields[4] = str_new("bytes");
+        fields[5] = value_int(st->bytes);
+        fields[6] = str_new("peak");
+        fields[7] = value_int(st->peak);
+        fields[8] = str_new("lengths");
+        fields[9] = lengths;
+        res[2*i] = name;
+        res[2*i+1] = fields;
+    }
+    obj_unref(stats);
+    return res;
+}
@@ -48,5 +48,6 @@ bool value_is_simple_map(PValue v);
 
 PValue value_parse(const char *str, ValueType type);
 const char *value_tostring(PValue v);
+PValue value_type_stats(bool all);
 
 #endif
@@ -0,0 +1,130 @@
+/*
+* llib little C library
+* BSD licence
+* Copyright Steve Donovan, 2013
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <llib/bmap.h>
+#include <llib/json.h>
+#include <llib/template.h>
+
+#define P (void *)
+
+void string_maps()
+{
+    MapKeyValue mk[] = {
+        {"gamma","C"},
+        {"alpha","A"},
+        {"beta","B"},
+        {NULL,NULL}
+    };
+    BMap *m = bmap_new_str_str();
+    bmap_put_keyvalues(m,mk);
+    // the map owns copies of the strings, and releases what it replaces
+    char key[10];
+    strcpy(key,"beta");
+    bool added = bmap_puts(m,key,"BB");
+    strcpy(key,"delta");
+    bmap_puts(m,key,"D");
+    printf("size %d added %d beta '%s'\n",bmap_size(m),added,(char*)bmap_gets(m,"beta"));
+    char *k, *v;
+    FOR_BMAP(k,v,m)
+        printf("%s='%s' ",k,v);
+    printf("\n");
+    bmap_delete(m,"alpha");
+    printf("alpha %d delta %d\n",bmap_contains(m,"alpha"),bmap_contains(m,"delta"));
+
+    // B-tree maps are Iterable and Accessors
+    StrTempl *st = str_templ_new("$(beta) and $(gamma)",NULL);
+    char *s = str_templ_subst_values(st,m);
+    printf("%s\n",s);
+    dispose(s,st);
+    s = json_tostring(m);
+    printf("%s\n",s);
+    unref(s);
+    unref(m);
+}
+
+// keys which only differ after the cached prefix, in many nodes
+void long_keys()
+{
+    BMap *m = bmap_new_str_ptr();
+    char key[40];
+    int n = 5000;
+    for (int i = n - 1; i >= 0; i--) {
+        sprintf(key,"a long common prefix %06d",i);
+        bmap_puti(m,key,(intptr_t)i);
+    }
+    for (int i = 0; i < n; i += 2) {
+        sprintf(key,"a long common prefix %06d",i);
+        bmap_delete(m,key);
+    }
+    char *k;
+    intptr_t v, last = -1;
+    int count = 0;
+    FOR_BMAP(k,v,m) {
+        assert(v > last && v % 2 == 1);
+        last = v;
+        ++count;
+    }
+    printf("size %d count %d last '%s'\n",bmap_size(m),count,k);
+    unref(m);
+}
+
+// integer keys put in a scrambled order, then mostly removed again
+void int_maps()
+{
+    BMap *m = bmap_new_ptr_ptr();
+    intptr_t n = 100000;
+    for (intptr_t i = 0; i < n; i++) {
+        intptr_t k = (i*7919) % n;
+        bmap_puti(m,k,k*2);
+    }
+    for (intptr_t i = 0; i < n; i++) {
+        if (i % 3 != 0)
+            bmap_delete(m,P i);
+    }
+    int found = 0;
+    for (intptr_t i = 0; i < n; i++) {
+        bool there = bmap_contains(m,P i);
+        assert(there == (i % 3 == 0));
+        if (there && bmap_geti(m,i) == i*2)
+            ++found;
+    }
+    intptr_t k, v;
+    int count = 0;
+    FOR_BMAP_FROM(k,v,m,50000) {
+        if (count++ == 0)
+            printf("from %d ",(int)k);
+    }
+    printf("count %d\n",count);
+    printf("size %d found %d\n",bmap_size(m),found);
+    for (intptr_t i = 0; i < n; i += 3)
+        bmap_delete(m,P i);
+    printf("empty %d\n",bmap_size(m) == 0 && m->root == NULL);
+    unref(m);
+}
+
+// values can be owned references
+void ref_maps()
+{
+    BMap *m = bmap_new_ptr_ref();
+    bmap_puti(m,1,str_new("one"));
+    bmap_puti(m,1,str_new("uno"));
+    bmap_puti(m,2,str_new("two"));
+    printf("%s %s\n",(char*)bmap_geti(m,1),(char*)bmap_geti(m,2));
+    unref(m);
+}
+
+int main()
+{
+    string_maps();
+    long_keys();
+    int_maps();
+    ref_maps();
+    printf("kount %d\n",obj_kount());
+    return 0;
+}
@@ -0,0 +1,123 @@
+/*
+* llib little C library
+* BSD licence
+* Copyright Steve Donovan, 2013
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <llib/fmap.h>
+#include <llib/json.h>
+#include <llib/template.h>
+
+#define P (void *)
+
+void string_maps()
+{
+    // the pairs need not be in order, and the last of a repeated key wins
+    MapKeyValue mk[] = {
+        {"jpeg","image/jpeg"},
+        {"html","text/html"},
+        {"css","text/css"},
+        {"js","text/javascript"},
+        {"html","text/html; charset=utf-8"},
+        {NULL,NULL}
+    };
+    FMap *m = fmap_new_str_str(mk,-1);
+    printf("size %d css '%s' html '%s' gif %d\n",fmap_size(m),(char*)fmap_gets(m,"css"),
+        (char*)fmap_gets(m,"html"),fmap_contains(m,"gif"));
+    char *k, *v;
+    FOR_FMAP(k,v,m)
+        printf("%s ",k);
+    printf("\n");
+
+    // flat maps are Iterable and Accessors
+    StrTempl *st = str_templ_new("$(css) and $(js)",NULL);
+    char *s = str_templ_subst_values(st,m);
+    printf("%s\n",s);
+    dispose(s,st);
+    s = json_tostring(m);
+    printf("%s\n",s);
+    dispose(s,m);
+}
+
+// keys which only differ after the cached prefix
+void long_keys()
+{
+    int n = 1000;
+    MapKeyValue *pkv = array_new(MapKeyValue,n);
+    char *buff = (char*)malloc(40*n);
+    for (int i = 0; i < n; i++) {
+        pkv[i].key = buff + 40*i;
+        sprintf((char*)pkv[i].key,"a long common prefix %06d",(i*7) % n);
+        pkv[i].value = P (intptr_t)((i*7) % n);
+    }
+    FMap *m = fmap_new_str_ptr(pkv,n);
+    // the keys were copied
+    free(buff);
+    unref(pkv);
+    char key[40];
+    int found = 0;
+    for (int i = 0; i < n; i++) {
+        sprintf(key,"a long common prefix %06d",i);
+        if (fmap_geti(m,key) == i)
+            ++found;
+    }
+    sprintf(key,"a long common prefix %06d",n);
+    printf("found %d missing %d\n",found,! fmap_contains(m,key));
+    unref(m);
+}
+
+// every size up to a few levels, looking for every key and between them
+void int_maps()
+{
+    int ok = 0;
+    for (int n = 0; n < 70; n++) {
+        MapKeyValue *pkv = array_new(MapKeyValue,n);
+        for (int i = 0; i < n; i++) {
+            pkv[i].key = P (intptr_t)(2*(n - i));
+            pkv[i].value = P (intptr_t)(n - i);
+        }
+        FMap *m = fmap_new_ptr_ptr(pkv,n);
+        for (intptr_t i = 0; i <= 2*n + 1; i++) {
+            bool there = fmap_contains(m,P i);
+            assert(there == (i > 0 && i % 2 == 0));
+            assert(! there || fmap_geti(m,i) == i/2);
+        }
+        intptr_t k, v, last = 0;
+        int count = 0;
+        FOR_FMAP(k,v,m) {
+            assert(k == last + 2);
+            last = k;
+            ++count;
+        }
+        assert(count == n);
+        ++ok;
+        dispose(m,pkv);
+    }
+    printf("sizes %d\n",ok);
+}
+
+// from a map; refcounted values are shared
+void from_map()
+{
+    Map *m = map_new_str_ref();
+    map_put(m,"one",str_new("1"));
+    map_put(m,"two",str_new("2"));
+    FMap *f = fmap_from_map(m);
+    unref(m);
+    printf("one '%s' two '%s'\n",(char*)fmap_gets(f,"one"),(char*)fmap_gets(f,"two"));
+    unref(f);
+}
+
+int main()
+{
+    string_maps();
+    long_keys();
+    int_maps();
+    from_map();
+    printf("kount %d\n",obj_kount());
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+* llib little C library
+* BSD licence
+* Copyright Steve Donovan, 2013
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <llib/hmap.h>
+#include <llib/json.h>
+#include <llib/template.h>
+
+#define P (void *)
+
+// hash maps are not ordered, so sort the pairs before showing them
+static void dump_sorted(HMap *m) {
+    MapKeyValue *pkv = hmap_to_array(m);
+    array_sort_struct_str(pkv,false,MapKeyValue,key);
+    FOR_ARR(MapKeyValue,p,pkv)
+        printf("%s='%s' ",(char*)p->key,(char*)p->value);
+    printf("\n");
+    unref(pkv);
+}
+
+void string_maps()
+{
+    MapKeyValue mk[] = {
+        {"alpha","A"},
+        {"beta","B"},
+        {"gamma","C"},
+        {NULL,NULL}
+    };
+    HMap *m = hmap_new_str_str();
+    hmap_put_keyvalues(m,mk);
+    // the map owns copies of the strings, and releases what it replaces
+    char key[10];
+    strcpy(key,"beta");
+    bool added = hmap_puts(m,key,"BB");
+    strcpy(key,"delta");
+    hmap_puts(m,key,"D");
+    printf("size %d added %d beta '%s'\n",hmap_size(m),added,(char*)hmap_gets(m,"beta"));
+    dump_sorted(m);
+    hmap_delete(m,"alpha");
+    printf("alpha %d delta %d\n",hmap_contains(m,"alpha"),hmap_contains(m,"delta"));
+
+    // hash maps are Iterable and Accessors
+    StrTempl *st = str_templ_new("$(beta) and $(gamma)",NULL);
+    char *s = str_templ_subst_values(st,m);
+    printf("%s\n",s);
+    dispose(s,st);
+    hmap_delete(m,"delta");
+    s = json_tostring(m);
+    printf("%s\n",s);
+    unref(s);
+    unref(m);
+}
+
+// counting is done in place
+void counting()
+{
+    const char *words[] = {"one","two","one","three","two","one",NULL};
+    HMap *m = hmap_new_str_ptr();
+    for (const char **w = words; *w; w++) {
+        intptr_t *count = (intptr_t*)hmap_put_ptr(m,P *w);
+        ++*count;
+    }
+    char *word;
+    intptr_t count;
+    int total = 0;
+    FOR_HMAP(word,count,m)
+        total += count;
+    printf("one %d two %d three %d total %d\n",(int)hmap_geti(m,"one"),(int)hmap_geti(m,"two"),
+        (int)hmap_geti(m,"three"),total);
+    unref(m);
+}
+
+// integer keys, with many removals moving entries back
+void int_maps()
+{
+    HMap *m = hmap_new_ptr_ptr();
+    intptr_t n = 100000;
+    int found = 0;
+    for (intptr_t i = 0; i < n; i++)
+        hmap_puti(m,i,i*2);
+    for (intptr_t i = 0; i < n; i += 3)
+        hmap_delete(m,P i);
+    for (intptr_t i = 0; i < n; i++) {
+        bool there = hmap_contains(m,P i);
+        assert(there == (i % 3 != 0));
+        if (there && hmap_geti(m,i) == i*2)
+            ++found;
+    }
+    printf("size %d found %d\n",hmap_size(m),found);
+    unref(m);
+}
+
+// values can be owned references
+void ref_maps()
+{
+    HMap *m = hmap_new_ptr_ref();
+    hmap_puti(m,1,str_new("one"));
+    hmap_puti(m,1,str_new("uno"));
+    hmap_puti(m,2,str_new("two"));
+    printf("%s %s\n",(char*)hmap_geti(m,1),(char*)hmap_geti(m,2));
+    unref(m);
+}
+
+int main()
+{
+    string_maps();
+    counting();
+    int_maps();
+    ref_maps();
+    printf("kount %d\n",obj_kount());
+    return 0;
+}
@@ -5,9 +5,11 @@
 */
 
 #include <stdio.h>
+#include <string.h>
 #include <llib/list.h>
 #include <llib/map.h>
 #include <llib/json.h>
+#include <llib/str.h>
 
 //const char *js = "{'one':[10,100], 'two':2, 'three':'hello'}";
 //const char *js = "{'one':1, 'two':2, 'three':'hello'}";
@@ -17,6 +19,40 @@
 
 const char *js = "[{'zwei':2,'twee':2},10,{'A':10,'B':[2,20]},[]]";
 
+typedef struct {
+    int x, y;
+} Point;
+
+// allocation statistics can be published as JSON
+void test_stats() {
+    Point *pts[3];
+    FOR(i,3)
+        pts[i] = obj_new(Point,NULL);
+    Point *arr = array_new(Point,5);
+    obj_unref(pts[0]);
+    PValue *stats = (PValue*)value_type_stats(false);
+    for (int i = 0; i < array_len(stats); i += 2) {
+        if (strcmp((char*)stats[i],"Point") == 0) {
+            char *s = json_tostring(stats[i+1]);
+            printf("Point %s\n",s);
+            obj_unref(s);
+        }
+    }
+    dispose(stats,arr,pts[1],pts[2]);
+}
+
+// with interned keys, repeated keys are the same string
+void test_intern() {
+    json_intern_keys(true);
+    PValue *arr = (PValue*)json_parse_string("[{'x':1,'y':2},{'y':4,'x':3}]");
+    char **a = (char**)arr[0], **b = (char**)arr[1];
+    char *y = str_intern("y");
+    printf("shared %d %d y %0.f\n",a[0] == b[2],a[2] == b[0],value_as_float(str_lookup(b,y)));
+    json_intern_keys(false);
+    dispose(arr,y);
+    str_intern_clear();
+}
+
 int main(int argc, char **argv)
 {
     PValue v;
@@ -89,6 +125,12 @@ int main(int argc, char **argv)
     puts(s);
     dispose(s,v);
 
+    printf("count = %d\n",obj_kount());
+
+    test_intern();
+    printf("count = %d\n",obj_kount());
+
+    test_stats();
     printf("count = %d\n",obj_kount());
     return 0;
 }
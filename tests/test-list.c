@@ -186,6 +186,15 @@ void test_wrapper()
 }
 
 
+// container nodes can come from slabs, not malloc
+void test_node_allocator()
+{
+    list_global_allocator(list_node_allocator());
+    test_int_list();
+    test_ref_list();
+    list_global_allocator(NULL);
+}
+
 int main() {
 
     printf("int lists\n");
@@ -199,6 +208,9 @@ int main() {
 
     printf("wrapper lists\n");
     test_wrapper();
+
+    printf("node allocator\n");
+    test_node_allocator();
     printf("kount %d\n",obj_kount());
     return 0;
 }
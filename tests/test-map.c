@@ -6,7 +6,9 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <assert.h>
 #include <llib/map.h>
+#include <llib/str.h>
 
 typedef struct {
     LIST_HEADER;
@@ -74,10 +76,9 @@ void struct_maps()
     }
     printf("\n");
 
-    // basic FOR_MAP has two problems:
-    // (1) key and value fields are plain void*
-    // (2) if you break out of the loop the iterator won't be cleared.
-    // Here is an explicit use of MapIter which sets typed variables
+    // basic FOR_MAP has key and value fields which are plain void*.
+    // Here is an explicit use of MapIter which sets typed variables;
+    // if you break out of the loop, the iterator must be cleared.
     char *key;
     Data *d;
     MapIter iter = map_iter_new (map,&key,&d);
@@ -90,6 +91,10 @@ void struct_maps()
     } while (map_iter_next(iter));
      printf("\n");
 
+    // a struct with the same key replaces the old one, even at the root
+    map_put_struct(map,Data_new("bob",23,1));
+    dump(D map_get(map,"bob"));
+
     dispose(map,rog);
 }
 
@@ -139,17 +144,196 @@ void int_maps()
     #undef puti
 
     map_remove(m,P 5);
+    // iterating does not allocate anything
+    int kount = obj_kount(), allocs = 0;
     FOR_MAP(iter,m) {
         printf("[%d]=%d,",INT iter->key,INT iter->value);
+        allocs += obj_kount() - kount;
     }
     printf("\n");
+    printf("allocs %d\n",allocs);
+    unref(m);
+}
+
+// keys arriving in order must not make the tree a list
+void sorted_maps()
+{
+    Map *m = map_new_ptr_ptr();
+    intptr_t n = 100000;
+    int found = 0;
+    for (intptr_t i = 1; i <= n; i++)
+        map_puti(m,i,i);
+    for (intptr_t i = 2; i <= n; i += 2)
+        map_delete(m,P i);
+    for (intptr_t i = n; i > 0; i--)
+        if (map_get(m,P i) == P i)
+            ++found;
+    printf("size %d found %d\n",map_size(m),found);
+    unref(m);
+}
+
+// ordered queries, as with a time series keyed by timestamp
+void range_maps()
+{
+    Map *m = map_new_ptr_ptr();
+    for (intptr_t t = 100; t > 0; t -= 10)
+        map_puti(m,t,t/10);
+    printf("lower %d upper %d none %d\n",INT map_lower_bound(m,P 25)->key,
+        INT map_upper_bound(m,P 30)->key,map_upper_bound(m,P 100) == NULL);
+    FOR_MAP_RANGE(iter,m,30,70)
+        printf("%d ",INT iter->key);
+    FOR_MAP_RANGE(iter,m,85,NULL)
+        printf("%d ",INT iter->key);
+    printf("\n");
+    printf("rank %d %d %d\n",map_rank(m,P 5),map_rank(m,P 55),map_rank(m,P 200));
+    printf("select %d %d %d none %d\n",INT map_select(m,0)->key,INT map_select(m,7)->key,
+        INT map_select(m,9)->key,map_select(m,10) == NULL);
+    unref(m);
+
+    // keys 0..999 in scrambled order; position and key agree
+    m = map_new_ptr_ptr();
+    for (intptr_t i = 0; i < 1000; i++)
+        map_puti(m,i*7 % 1000,i);
+    for (intptr_t k = 0; k < 1000; k++) {
+        assert(INT map_select(m,k)->key == k);
+        assert(map_rank(m,P k) == k);
+    }
+    int n = 0;
+    FOR_MAP_RANGE(iter,m,100,200)
+        n += INT iter->key == 100 + n;
+    assert(n == 100);
+
+    // the sizes are kept up to date by puts, removes, merges and rebuilds
+    for (intptr_t i = 1000; i < 3000; i++)
+        map_puti(m,1000 + (i*7 % 2000),i);
+    for (intptr_t k = 0; k < 3000; k += 2)
+        map_delete(m,P k);
+    MapKeyValue more[] = {{P 3001,P 1},{P 3003,P 1},{P 3005,P 1}};
+    map_put_sorted(m,more,3);
+    for (intptr_t k = 0; k < 1503; k++) {
+        assert(INT map_select(m,k)->key == 2*k + 1);
+        assert(map_rank(m,P (2*k + 1)) == k);
+    }
     unref(m);
 }
 
+// maps can be built from sorted pairs, and merged, in linear time
+void bulk_maps()
+{
+    MapKeyValue mk[] = {
+        {"alpha","A"},
+        {"beta","B"},
+        {"delta","D"},
+        {NULL,NULL}
+    };
+    MapKeyValue more[] = {
+        {"beta","BB"},
+        {"gamma","C"},
+        {NULL,NULL}
+    };
+    Map *m = map_new_str_str(), *other = map_new_str_str();
+    map_put_sorted(m,mk,-1);
+    map_put_sorted(other,more,-1);
+    map_merge(m,other);
+    unref(other);
+    FOR_MAP(iter,m)
+        printf("%s='%s' ",(char*)iter->key,(char*)iter->value);
+    printf("size %d\n",map_size(m));
+    unref(m);
+
+    // a sorted array makes a balanced tree
+    MapKeyValue *pkv = array_new(MapKeyValue,100000);
+    FOR(i,100000) {
+        pkv[i].key = P (intptr_t)i;
+        pkv[i].value = P (intptr_t)(2*i);
+    }
+    m = map_new_ptr_ptr();
+    map_put_sorted(m,pkv,array_len(pkv));
+    assert(map_geti(m,99999) == 199998 && INT map_select(m,500)->key == 500);
+    // not sorted, so put one by one
+    pkv[0].key = P 100000;
+    map_put_sorted(m,pkv,2);
+    printf("size %d last %d\n",map_size(m),INT map_select(m,100000)->key);
+    dispose(m,pkv);
+
+    // a replaced value is released, whether the pairs are sorted or not
+    char *one = str_new("one"), *two = str_new("two");
+    m = map_new_str_ref();
+    map_puts(m,"a",ref(one));
+    MapKeyValue sorted[] = {{"a",ref(two)},{"b",str_new("b")}};
+    map_put_sorted(m,sorted,2);
+    MapKeyValue unsorted[] = {{"b",str_new("bb")},{"a",ref(one)}};
+    map_put_sorted(m,unsorted,2);
+    printf("replaced %d %d '%s'\n",obj_refcount(two),obj_refcount(one),(char*)map_get(m,"b"));
+    dispose(m,one,two);
+}
+
+// a map can have its own slab of nodes, which goes all at once
+void slab_maps()
+{
+    Map *m = map_new_str_ref();
+    map_use_node_slab(m);
+    FOR(i,1000)
+        map_put(m,str_fmt("%d",i),str_fmt("value %d",i));
+    char key[20];
+    FOR(i,500) {
+        sprintf(key,"%d",2*i);
+        map_delete(m,key);
+    }
+    printf("size %d '%s'\n",map_size(m),(char*)map_get(m,"999"));
+    map_clear(m);
+    map_puts(m,"one",str_new("1"));
+    Map *ints = map_new_ptr_ptr();
+    map_use_node_slab(ints);
+    for (intptr_t i = 0; i < 1000; i++)
+        map_puti(ints,i,i);
+    dispose(m,ints);
+}
+
+// interned keys are shared between maps, and found by pointer first
+void interned_maps()
+{
+    Map *m1 = map_new_istr_ptr(), *m2 = map_new_istr_ref();
+    char key[20];
+    FOR(i,100) {
+        sprintf(key,"k%d",i);
+        map_puti(m1,key,(intptr_t)i);
+        map_put(m2,str_new(key),str_fmt("v%d",i));
+    }
+    char *k42 = str_intern("k42");
+    PEntry e1 = map_lower_bound(m1,k42), e2 = map_lower_bound(m2,"k42");
+    printf("shared %d %d '%s' %d\n",e1->key == k42,e2->key == k42,
+        (char*)map_get(m2,k42),(int)map_geti(m1,"k42"));
+    dispose(m1,m2,k42);
+
+    // the canonical copy outlives the arena or pool it was first interned in
+    char *k1, *k2;
+    {
+        scoped_arena;
+        k1 = str_intern("some interned key");
+    }
+    {
+        scoped_pool;
+        k2 = str_intern("another interned key");
+    }
+    unref(k1);
+    unref(k2);
+    k1 = str_intern("some interned key");
+    k2 = str_intern("another interned key");
+    printf("outlived '%s' '%s'\n",k1,k2);
+    dispose(k1,k2);
+    str_intern_clear();
+}
+
 int main () {
     struct_maps();
     int_maps();
+    sorted_maps();
+    range_maps();
+    bulk_maps();
+    slab_maps();
     string_maps();
+    interned_maps();
     printf("kount %d\n",obj_kount());
     return 0;
 }
@@ -5,7 +5,10 @@
 */
 
 #include <stdio.h>
-#include <llib/obj.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <llib/str.h>
 
 typedef struct {
     int *ages;
@@ -32,6 +35,16 @@ void test_bonzo() {
     unref(b);
 }
 
+// allocations are counted for each type
+void test_type_stats() {
+    ObjTypeStats *stats = obj_type_stats(false);
+    FOR_ARR(ObjTypeStats,st,stats) {
+        if (strcmp(st->name,"Bonzo") == 0)
+            printf("Bonzo live %d allocs %d\n",(int)st->live,(int)st->allocs);
+    }
+    obj_unref(stats);
+}
+
 typedef char *Str;
 
 #define discard obj_unref_v
@@ -56,6 +69,111 @@ void test_strings() {
     unref(strs);
 }
 
+// small objects come from the size classes
+static int slab_used(int size) {
+    SlabStats *stats = obj_slab_stats();
+    int used = -1;
+    FOR_ARR(SlabStats,st,stats) {
+        if (st->size == size) {
+            used = st->used;
+            break;
+        }
+    }
+    obj_unref(stats);
+    return used;
+}
+
+void test_slab() {
+    int before = slab_used(32);
+    char **strs = array_new(char*,100);
+    FOR(i,100)
+        strs[i] = str_new("hello dolly");
+    assert(slab_used(32) == before + 100);
+    FOR(i,100)
+        obj_unref(strs[i]);
+    assert(slab_used(32) == before);
+    obj_unref(strs);
+}
+
+// type lookup stays correct with many types registered
+int obj_typeof_(const char *name);
+
+static void counter_dispose(int *p) {
+}
+
+void test_types() {
+    char **names = array_new_ref(char*,300);
+    int *types = array_new(int,300);
+    FOR(i,300) {
+        names[i] = str_fmt("Type%d",i);
+        types[i] = obj_new_type_(8,names[i],NULL);
+    }
+    FOR(i,300)
+        assert(obj_typeof_(names[i]) == types[i]);
+    // plain and cached lookups agree
+    int *p1 = (int*)obj_new_(sizeof(int),"Counter",(DisposeFn)counter_dispose);
+    int *p2 = obj_new(int,counter_dispose);
+    assert(obj_type_index(p1) == obj_type_index(p2));
+    assert(obj_typeof_("NoSuchType") == -1);
+    dispose(p1,p2);
+    dispose(names,types);
+}
+
+// a chain of a million nested arrays would blow the stack if freed recursively
+void test_deep_free() {
+    void **head = NULL;
+    FOR(i,1000000) {
+        void **link = array_new_ref(void*,1);
+        link[0] = head;
+        head = link;
+    }
+    unref(head);
+    // dead objects can be freed in batches
+    char **strs = array_new_ref(char*,10000);
+    FOR(i,10000)
+        strs[i] = str_fmt("%d",i);
+    obj_defer_free(true);
+    unref(strs);
+    printf("dead %d\n",obj_collect(1000));
+    printf("dead %d\n",obj_collect(-1));
+    obj_defer_free(false);
+}
+
+// only pointers to live llib objects have a refcount
+void test_ownership() {
+    char *s = str_new("hello");
+    char *big = str_new_size(10000);
+    char *plain = (char*)malloc(100);
+    char *dead = str_new("dead");
+    unref(dead);
+    printf("ours %d %d\n",obj_refcount(s),obj_refcount(big));
+    printf("not ours %d %d %d %d\n",obj_refcount("static"),obj_refcount(plain),
+        obj_refcount(s+1),obj_refcount(dead));
+    free(plain);
+    dispose(s,big);
+}
+
+// the profiler attributes sampled bytes to allocation sites
+typedef struct {
+    double x, y;
+} Sampled;
+
+void test_profile() {
+    Sampled *objs[4];
+    obj_profile_start(1); // every allocation
+    FOR(i,4)
+        objs[i] = obj_new(Sampled,NULL);
+    obj_profile_stop();
+    unref(objs[0]);
+    char *live = obj_profile_report(OBJ_PROFILE_LIVE);
+    char *freed = obj_profile_report(OBJ_PROFILE_FREED);
+    // just the type and bytes, since frames may be addresses
+    printf("live %s",strrchr(live,';')+1);
+    printf("freed %s",strrchr(freed,';')+1);
+    dispose(live,freed,objs[1],objs[2],objs[3]);
+    obj_profile_reset();
+}
+
 int main() {
     int *pa = array_new(int,10);
     int *pb = ref(pa);
@@ -69,8 +187,14 @@ int main() {
     printf("\n");
     printf("len %d\n",array_len(pa));
     test_bonzo();
+    test_type_stats();
     test_string();
     test_strings();
+    test_slab();
+    test_types();
+    test_deep_free();
+    test_ownership();
+    test_profile();
     discard(pb,pa,p,sl);
     printf("kount %d\n",obj_kount());
     return 0;
@@ -28,9 +28,58 @@ void make_orphans_freely()
     throw_away_loads_of_objects();    
 }
 
+// a live seq left in a pool, and objects unref'd out of an enclosing pool
+void nested_pools()
+{
+    scoped_pool;
+    int **seq = seq_new(int);
+    FOR(i,100)
+        seq_add(seq,i);
+    char *outer = str_new("outer");
+    {
+        scoped_pool;
+        char *inner = str_new("inner");
+        unref(outer);
+        unref(inner);
+        printf("inner pool %d\n",obj_pool_count(P_));
+    }
+    printf("outer pool %d\n",obj_pool_count(P_));
+}
+
+static int n_disposed;
+
+static void count_dispose(int *p) {
+    ++n_disposed;
+}
+
+// nothing in an arena is freed until the arena goes
+void arena_objects()
+{
+    char *heap = str_new("heap");
+    char *kept;
+    {
+        scoped_arena;
+        char **strs = array_new_ref(char*,1000);
+        FOR(i,1000)
+            strs[i] = str_fmt("item %d",i);
+        unref(strs[10]); // does nothing
+        strs[999] = ref(heap);
+        FOR(i,3)
+            obj_new(int,count_dispose);
+        kept = (char*)obj_promote(strs[42]);
+        printf("arena '%s' '%s' %d\n",strs[10],heap,obj_refcount(heap));
+        // the arena knows where its objects start
+        printf("ours %d %d %d\n",obj_refcount(strs[10]),obj_refcount(strs[10] + 16),obj_refcount(strs));
+    }
+    printf("kept '%s' %d disposed %d\n",kept,obj_refcount(heap),n_disposed);
+    dispose(kept,heap);
+}
+
 int main()
 {    
     make_orphans_freely();
+    nested_pools();
+    arena_objects();
     DI(obj_kount());
     return 0;
 }
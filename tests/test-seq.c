@@ -109,5 +109,35 @@ int main()
     seq_insert(bb,1,&b,1);
     assert((*bb)[1] == 21);
 
+    // growing in place keeps the values
+    int **big = seq_new(int);
+    long long sum = 0;
+    FOR(i,100000) {
+        seq_add(big,i);
+        sum += i;
+    }
+    FOR(i,array_len(*big))
+        sum -= (*big)[i];
+    printf("grown %d sum %d\n",array_len(*big),(int)sum);
+    seq_reserve(big,300000);
+    printf("reserved %d cap %d\n",array_len(*big),seq_cap(big));
+    int vals[] = {1,2,3};
+    int idx = seq_add_n(big,vals,3);
+    seq_add_n(big,NULL,2);
+    printf("added at %d: %d %d %d %d %d\n",idx,(*big)[idx],(*big)[idx+1],(*big)[idx+2],
+        (*big)[idx+3],(*big)[idx+4]);
+    seq_shrink_to_fit(big);
+    printf("shrunk %d cap %d\n",array_len(*big),seq_cap(big));
+    unref(big);
+
+    // cutting off the end of a reference array releases those elements
+    sf = seq_new_ref(PFoo);
+    FOR (i,3)
+        seq_add(sf,foo_new());
+    PFoo *foos = (PFoo*)seq_array_ref(sf);
+    foos = (PFoo*)array_resize(foos,1);
+    printf("resized %d\n",array_len(foos));
+    unref(foos);
+
     return 0;
 }
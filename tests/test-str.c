@@ -34,6 +34,163 @@ void test_split()
     assert(str_eq(words[1],"beta, gamma"));
     //printf("'%s' '%s'\n",words[1],words[2]);
     dispose(words);
+
+    // splitting into one block, which may keep empty fields
+    words = str_split_block("alpha, beta, gamma",", ",0);
+    assert(array_len(words) == 3 && str_eq(words[2],"gamma") && words[3] == NULL);
+    dispose(words);
+    words = str_split_block("alpha, beta, gamma",", ",1);
+    assert(array_len(words) == 2 && str_eq(words[1],"beta, gamma"));
+    dispose(words);
+    words = str_split_block(",one,,a field longer than sixteen bytes,",",",STR_EMPTY);
+    assert(array_len(words) == 5 && str_eq(words[0],"") && str_eq(words[2],""));
+    assert(str_eq(words[3],"a field longer than sixteen bytes") && str_eq(words[4],""));
+    dispose(words);
+    words = str_split_block("",",",STR_EMPTY);
+    assert(array_len(words) == 1 && str_eq(words[0],""));
+    dispose(words);
+    words = str_split_block("a:b;c d-e_f|g",":; -_|",0);
+    assert(array_len(words) == 7 && str_eq(words[6],"g"));
+    dispose(words);
+}
+
+// big smaps are indexed; the index must follow additions, updates and resizes
+void test_smap()
+{
+    char key[20];
+    char ***sm = smap_new(true);
+    for (int i = 0; i < 100; i++) {
+        sprintf(key,"key%d",i);
+        smap_add(sm,str_new(key),str_fmt("%d",i));
+        // a lookup after each addition builds and extends the index
+        assert(str_eq((char*)smap_get(sm,key),key+3));
+        assert(smap_get(sm,"key") == NULL);
+    }
+    smap_put(sm,"key50",str_new("fifty"));
+    assert(str_eq((char*)smap_get(sm,"key50"),"fifty"));
+    assert(smap_len(sm) == 100);
+    char **m = smap_close(sm);
+    for (int i = 0; i < 100; i++) {
+        sprintf(key,"key%d",i);
+        assert(str_lookup_ptr(m,key) == (void**)&m[2*i+1]);
+    }
+    assert(str_lookup(m,"key100") == NULL);
+    unref(m);
+}
+
+// a string ends at its first nul, whatever its array length; the _len functions take one
+void test_lengths()
+{
+    char *big = str_new_size(1000);
+    memset(big,'x',1000);
+    big[500] = '\0';   // cut short in place
+    char *copy = str_new(big);
+    assert(str_len(copy) == 500);
+
+    // a buffer written with a shorter string
+    char *buff = str_new_size(100);
+    strcpy(buff,"a buffer holding rather fewer than 100 chars");
+    char *field = str_new("name=value");
+    field[4] = '\0';
+    assert(str_ends_with(buff,"chars") && ! str_ends_with(field,"value"));
+    assert(str_findstr(field,"value") == -1 && str_len(field) == 10);
+
+    char *bin = str_new_len("one\0two\0",8);
+    assert(str_len(bin) == 8 && bin[4] == 't');
+    assert(str_findstr_len(bin,8,"\0two",4) == 3);
+    assert(str_findstr_len(bin,8,"two!",4) == -1);
+    Str *ss = strbuf_new();
+    strbuf_adds_len(ss,bin,8);
+    strbuf_adds(ss,big);
+    strbuf_adds(ss,buff);
+    assert(array_len(*ss) == 552 && (*ss)[9] == 'x');
+
+    // concat and trim leave the right lengths
+    char **strs = array_new(char*,3);
+    strs[0] = "a"; strs[1] = "bb"; strs[2] = big;
+    char *joined = str_concat(strs,", ");
+    assert(str_len(joined) == strlen(joined) && strlen(joined) == 507);
+    char *padded = str_fmt("  %s  ",big);
+    str_trim(padded);
+    assert(str_len(padded) == 500 && str_eq(padded,big));
+    dispose(big,copy,buff,field,bin,strbuf_tostring(ss),strs,joined,padded);
+}
+
+// views look into a string without copying it
+void test_views()
+{
+    const char *line = "  alpha, beta,,gamma  ";
+    StrView v = str_view_trim(str_view(line));
+    assert(str_view_eq(v,"alpha, beta,,gamma"));
+    assert(str_view_eq(str_view_sub(v,0,5),"alpha"));
+    assert(str_view_eq(str_view_sub(v,-6,-1),"gamma"));
+    assert(str_view_findch(v,',') == 5 && str_view_findstr(v,"gamma") == 13);
+    assert(str_view_findstr(str_view_sub(v,0,5),"beta") == -1);
+
+    const char *expect[] = {"alpha","beta","gamma"};
+    int i = 0;
+    FOR_STR_VIEW_SPLIT(f,"alpha, beta,,gamma",", ")
+        assert(str_view_eq(f,expect[i++]));
+    assert(i == 3);
+
+    StrView *parts = str_view_split("a/b//c","/");
+    assert(array_len(parts) == 3 && str_view_eq(parts[2],"c"));
+    char *s = str_view_str(parts[1]);
+    assert(str_eq(s,"b") && str_len(s) == 1);
+    dispose(parts,s);
+}
+
+// the searches give the same answers with and without SIMD, at every
+// offset and length around the vector sizes. Long refcounted strings
+// are searched with SIMD within their arrays, up to the first nul
+void test_search()
+{
+    for (int level = 0; level <= 2; level++) {
+        str_simd_level(level);
+        for (int n = 0; n < 150; n++) {
+            char *buff = str_new_size(n);
+            memset(buff,'a',n);
+            assert(str_findstr_len(buff,n,"aab",3) == -1);
+            assert(str_findstr(buff,"ab") == -1 && str_find_first_of(buff,",;") == -1);
+            assert(str_is_blank(buff) == (n == 0));
+            for (int i = 0; i + 2 <= n; i++) {
+                buff[i] = 'x';
+                buff[n-1] = ';';
+                assert(str_findstr(buff,"x") == i);
+                assert(str_findstr(buff,i + 2 < n ? "xa" : "x;") == i);
+                assert(str_findstr_len(buff,n,i + 2 < n ? "xa" : "x;",2) == i);
+                assert(i + 3 >= n || str_findstr_len(buff,n,"xaa",3) == i);
+                assert(str_find_first_of(buff,"x;") == i);
+                assert(str_find_first_of(buff,"xyz;:,") == i);
+                assert(str_find_first_of(buff,"\xe9\xe8xyz;") == i);
+                assert(str_find_first_of(buff,"0123456789x") == i);
+                assert(str_find_first_not_of(buff,"a") == (i == 0 ? -1 : i));
+                memset(buff,' ',i);
+                assert(str_find_first_not_of(buff," \t") == (i == 0 ? -1 : i));
+                memset(buff,'a',n);
+            }
+            unref(buff);
+        }
+        // a long buffer holding a shorter string: nothing past the nul is found
+        char *buff = str_new_size(200);
+        memset(buff,'a',200);
+        memcpy(buff + 150,";needle x",9);
+        for (int n = 64; n < 150; n += 5) {
+            buff[n] = '\0';
+            assert(str_findstr(buff,"needle") == -1 && str_find_first_of(buff,";x") == -1);
+            assert(str_find_first_of(buff,"xyz;:,") == -1 && str_find_first_not_of(buff,"a") == n);
+            memset(buff,' ',n);
+            assert(str_is_blank(buff));
+            memset(buff,'a',n + 1);
+        }
+        unref(buff);
+        char *s = str_fmt("   \t%60s \n",", long enough to need more than one block");
+        str_trim(s);
+        assert(str_starts_with(s," ") == false && str_ends_with(s,"block"));
+        assert(str_findstr(s,"more than one") == (int)strlen(s) - 19);
+        unref(s);
+    }
+    str_simd_level(2);
 }
 
 int main()
@@ -85,6 +242,10 @@ int main()
     assert(*str_end("") == '\0'); 
 
     test_split();
+    test_smap();
+    test_lengths();
+    test_views();
+    test_search();
 
     s = str_new("  hello dolly ");
     str_trim(s);
@@ -23,6 +23,8 @@ int main(int argc, char**argv)
     for (Str *P = t->col_names; *P; ++P,++R)
         printf("'%s' (%s),",*P,*R);
     printf("\n");
+    // the fields are refcounted strings
+    printf("refs %d %d\n",obj_refcount(t->col_names[0]),obj_refcount(t->rows[1][0]));
 
     int *ages = (int*)t->cols[1];
     char **names = (char**)t->cols[0];
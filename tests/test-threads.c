@@ -0,0 +1,103 @@
+// stress test for the thread-safe build (libllib_mt.a, built with LLIB_THREADS)
+#include <stdio.h>
+#include <pthread.h>
+#include <llib/str.h>
+
+#define NTHREADS 8
+#define N 100000
+
+// strings shared by all the workers
+static char **shared;
+
+typedef struct {
+    int id;
+    int type;      // index of a type which every worker asks for
+    int left;      // objects left in the worker's pool before it drains
+    char **given;  // objects handed back to the main thread
+} Work;
+
+static void *worker(void *arg) {
+    Work *w = (Work*)arg;
+    int ns = array_len(shared);
+
+    // hammer the refcounts of the shared objects
+    FOR(i,N) {
+        char *s = ref(shared[i % ns]);
+        if (s[0] != 'S')
+            printf("bad shared string\n");
+        unref(s);
+    }
+
+    // the type registry; everyone adds their own types and resolves a common one
+    FOR(i,50)
+        obj_new_type_(sizeof(int),str_fmt("T%d_%d",w->id,i),NULL);
+    int *common = (int*)array_new_(sizeof(int),"Common",1,0);
+    w->type = obj_type_index(common);
+    unref(common);
+
+    // each worker has its own object pool
+    {
+        scoped_pool;
+        FOR(i,N/10)
+            str_fmt("%d:%d",w->id,i);
+        w->left = obj_pool_count(P_);
+    }
+
+    // interned strings are released by whichever thread clears the table
+    char *name = str_fmt("interned %d",w->id);
+    char *own_name = str_intern(name);
+    char *common_name = str_intern("interned");
+    dispose(name,own_name,common_name);
+
+    // objects created here but released by another thread
+    if (w->id % 2 == 0) {
+        scoped_shared;
+        w->given = array_new_ref(char*,100);
+        FOR(i,100)
+            w->given[i] = str_fmt("given %d",i);
+    } else {
+        w->given = array_new_ref(char*,100);
+        FOR(i,100)
+            w->given[i] = str_fmt("given %d",i);
+        obj_transfer(w->given);
+    }
+    return NULL;
+}
+
+int main()
+{
+    pthread_t threads[NTHREADS];
+    Work work[NTHREADS];
+    int kount = obj_kount();
+
+    shared = array_new_ref(char*,10);
+    FOR(i,10)
+        shared[i] = str_fmt("S%d",i);
+
+    FOR(i,NTHREADS) {
+        work[i].id = i;
+        pthread_create(&threads[i],NULL,worker,&work[i]);
+    }
+    FOR(i,NTHREADS)
+        pthread_join(threads[i],NULL);
+
+    int refs = 0, agreed = 1, left = 0;
+    FOR(i,10)
+        refs += obj_refcount(shared[i]);
+    FOR(i,NTHREADS) {
+        agreed = agreed && work[i].type == work[0].type;
+        left += work[i].left;
+        // handing over an object makes it ours
+        if (i == 0 && ! obj_adopt(work[i].given))
+            printf("could not adopt\n");
+        unref(work[i].given);
+    }
+    printf("shared refcounts %d\n",refs);
+    printf("types agreed %d\n",agreed);
+    printf("pooled objects %d\n",left);
+    unref(shared);
+    str_intern_clear();
+    // the names of registered types live for ever
+    printf("kount %d\n",obj_kount() - kount - NTHREADS*50);
+    return 0;
+}
@@ -34,9 +34,7 @@ PValue kount(PValue *args) {
     // this tells you what was created/destroyed by type and number
     obj_snapshot_dump();
     obj_snapshot_create();
-#endif
-#ifdef LLIB_PTR_LIST
-    // if llib is managing an explicit list of used pointers, can tell us exactly what they are
+    // llib keeps a set of live pointers, so it can tell us exactly what they are
     obj_snap_ptrs_dump();
     obj_snap_ptrs_create();
 #endif